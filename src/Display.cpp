@@ -4,6 +4,8 @@ Display::Display(Spectrum48KMemory* memory)
     : m_memory(memory),
       m_inverted(false),
       m_frames(0),
+      m_flashChanged(false),
+      m_pixelsChanged(false),
       m_scale(2.0f)
 {
     // TODO: error handling
@@ -83,42 +85,25 @@ void Display::draw(int windowWidth, int windowHeight)
 {
     // TODO: error handling
 
-    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++)
+    // Only cells written since the last frame are drawn again, and the
+    // flashing ones when the colors were inverted
+    m_pixelsChanged = false;
+    for (int row = 0; row < Spectrum48KMemory::SCREEN_ROWS; row++)
     {
-        for (uint8_t x = 0; x < DISPLAY_WIDTH/8; x++)
+        if (!m_memory->isScreenRowDirty(row) && !m_flashChanged) { continue; }
+        for (int column = 0; column < Spectrum48KMemory::SCREEN_COLUMNS; column++)
         {
-            uint16_t memY = 0x4000 | ((y >> 6) << 11);
-            memY |= (y & 0x7) << 8;
-            memY |= ((y >> 3) & 0x7) << 5;
-
-            uint16_t memPos = memY |= x;
-            for (uint8_t bit = 0; bit < 8; bit++)
+            int cell = row * Spectrum48KMemory::SCREEN_COLUMNS + column;
+            uint8_t attributes = m_memory->screenColorData[cell];
+            if (m_memory->isScreenCellDirty(cell) || (m_flashChanged && (attributes & 0x80)))
             {
-                // Find the corresponding color attributes
-                // http://www.animatez.co.uk/computers/zx-spectrum/screen-memory-layout/
-                int xReal = x * 8 + bit;
-                uint16_t memCol = 0x5800 + ( (y / 8) * (DISPLAY_WIDTH / 8) + (xReal / 8) );
-                uint8_t attributes = (*m_memory)[memCol];
-
-                // Find the color (each is stored as 1 bit per channel in GRB format)
-                bool col = ((*m_memory)[memPos] & (1 << (7 - bit)));
-                col = (m_inverted && (col >> 7)) ? !col : col;
-                uint8_t r = col ? (attributes & 0x2) >> 1 : (attributes & 0x10) >> 4;
-                uint8_t g = col ? (attributes & 0x4) >> 2 : (attributes & 0x20) >> 5;
-                uint8_t b = col ? (attributes & 0x1) : (attributes & 0x8) >> 3;
-
-                // Adjust by brightness flag
-                r *= (attributes & 0x40) ? 255 : 128;
-                g *= (attributes & 0x40) ? 255 : 128;
-                b *= (attributes & 0x40) ? 255 : 128;
-
-                m_pixels[ (DISPLAY_WIDTH * y + (x*8+bit)) * 3 ] = b;
-                m_pixels[ (DISPLAY_WIDTH * y + (x*8+bit)) * 3 + 1 ] = g;
-                m_pixels[ (DISPLAY_WIDTH * y + (x*8+bit)) * 3 + 2 ] = r;
-
+                drawCell(row, column);
+                m_pixelsChanged = true;
             }
         }
     }
+    m_memory->clearScreenDirty();
+    m_flashChanged = false;
 
     glDraw(windowWidth, windowHeight);
 
@@ -127,6 +112,39 @@ void Display::draw(int windowWidth, int windowHeight)
     {
         m_frames = 0;
         m_inverted = !m_inverted;
+        m_flashChanged = true;
+    }
+}
+
+void Display::drawCell(int row, int column)
+{
+    // Through screenMemory, the 128K may show its shadow screen
+    uint8_t attributes = m_memory->screenColorData[row * Spectrum48KMemory::SCREEN_COLUMNS + column];
+
+    for (int line = 0; line < 8; line++)
+    {
+        int y = row * 8 + line;
+        // http://www.animatez.co.uk/computers/zx-spectrum/screen-memory-layout/
+        uint16_t memPos = ((y >> 6) << 11) | ((y & 0x7) << 8) | (((y >> 3) & 0x7) << 5) | column;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            // Find the color (each is stored as 1 bit per channel in GRB format)
+            bool col = (m_memory->screenMemory[memPos] & (1 << (7 - bit)));
+            col = (m_inverted && (col >> 7)) ? !col : col;
+            uint8_t r = col ? (attributes & 0x2) >> 1 : (attributes & 0x10) >> 4;
+            uint8_t g = col ? (attributes & 0x4) >> 2 : (attributes & 0x20) >> 5;
+            uint8_t b = col ? (attributes & 0x1) : (attributes & 0x8) >> 3;
+
+            // Adjust by brightness flag
+            r *= (attributes & 0x40) ? 255 : 128;
+            g *= (attributes & 0x40) ? 255 : 128;
+            b *= (attributes & 0x40) ? 255 : 128;
+
+            int x = column * 8 + bit;
+            m_pixels[ (DISPLAY_WIDTH * y + x) * 3 ] = b;
+            m_pixels[ (DISPLAY_WIDTH * y + x) * 3 + 1 ] = g;
+            m_pixels[ (DISPLAY_WIDTH * y + x) * 3 + 2 ] = r;
+        }
     }
 }
 
@@ -140,7 +158,10 @@ void Display::glDraw(int width, int height)
     glUniformMatrix4fv(MatrixID, 1, GL_FALSE, mvp.data());
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, m_textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, DISPLAY_WIDTH, DISPLAY_HEIGHT, 0, GL_BGR, GL_UNSIGNED_BYTE, m_pixels);
+    if (m_pixelsChanged)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, DISPLAY_WIDTH, DISPLAY_HEIGHT, 0, GL_BGR, GL_UNSIGNED_BYTE, m_pixels);
+    }
     glUniform1i(m_samplerID, 0);
     glEnableVertexAttribArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
@@ -34,6 +34,9 @@ class Display {
         bool compileShader(std::string code, GLuint shaderID);
         GLuint linkShaderProgram(GLuint vertexShaderID, GLuint fragmentShaderID);
 
+        // Render the 8x8 pixels of a character cell into m_pixels
+        void drawCell(int row, int column);
+
         // Draw generated pixel buffer using openGL
         void glDraw(int windowWidth, int windowHeight);
     private:
@@ -56,6 +59,11 @@ class Display {
 
         // Number of frames since last inversion of colors
         int m_frames;
+
+        // The colors were inverted since the last draw, flashing cells are stale
+        bool m_flashChanged;
+        // m_pixels was drawn into and the texture needs uploading
+        bool m_pixelsChanged;
 };
 
 #endif
\ No newline at end of file
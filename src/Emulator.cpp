@@ -4,22 +4,38 @@
 #include <chrono>
 #include <SDL.h>
 #include <algorithm>
+#include <cstdio>
 #include "Z80.h"
 #include "ULA.h"
 
-Emulator::Emulator(SDL_Window* window)
+Emulator::Emulator(SDL_Window* window, bool spectrum128K)
     :
-    m_memory(), 
-    display(&m_memory), 
+    m_memory48K(),
+    m_memory128K(spectrum128K ? new Spectrum128KMemory() : nullptr),
+    m_memory(m_memory128K ? m_memory128K.get() : &m_memory48K),
+    display(m_memory), 
     input(), 
     sound(), 
     m_window(window),
     m_debugger(), 
     m_ula(&input),
-    m_proc(&m_memory, &m_ula, &m_debugger)
+    m_proc(m_memory, &m_ula, &m_debugger),
+    m_snapshots(&m_proc, m_memory),
+    m_lastStateHash(0)
 
 
 {
+    if (m_memory128K)
+    {
+        m_paging.reset(new Spectrum128KPaging(m_memory128K.get()));
+        m_proc.getIoPorts()->registerDevice(m_paging.get());
+        m_contention.reset(new ULAContention(m_memory128K.get(), m_proc.getRegisters()));
+    }
+    else
+    {
+        m_contention.reset(new ULAContention(m_memory, m_proc.getRegisters()));
+    }
+    m_proc.setFrameCycles(m_contention->getTiming().frameCycles);
     init();
     m_prevFrameTime = std::chrono::high_resolution_clock::now();
     
@@ -29,6 +45,7 @@ void Emulator::init()
 {
 
     m_proc.init();
+    m_proc.setFrameInterrupt(true);
     
 }
 
@@ -47,12 +64,13 @@ void Emulator::loadROM(const std::string filename)
     int length = file.tellg();
     file.seekg(0, std::ios::beg);
 
-    if (length != EXPECTED_ROM_SIZE) {
+    if (length != (m_memory128K ? 2 * EXPECTED_ROM_SIZE : EXPECTED_ROM_SIZE)) {
         std::cerr << "Unexpected ROM size." << std::endl;
         return;
     }
-    file.read(reinterpret_cast<char*>(m_memory.ROM), length);
+    file.read(reinterpret_cast<char*>(m_memory->ROM), length);
     file.close();
+    m_memory->touchAll();
 
     m_ROMfile = filename;
 }
@@ -91,8 +109,17 @@ bool Emulator::loop()
         int w, h;
         SDL_GetWindowSize(m_window, &w, &h);
 
-        m_proc.nmi();
+        // Only pay for breakpoint checks and tracing while they can trigger
+        m_proc.setDebugging(m_debugger.getBreakpointsCount() > 0 || m_debugger.shouldBreak());
         m_proc.simulateFrame();
+        m_lastStateHash = m_stateHash.update(m_proc, *m_memory);
+        if (m_stateHashLog.is_open())
+        {
+            char line[64];
+            snprintf(line, sizeof(line), "%d %016llx %016llx\n", m_stateHash.getFrames() - 1,
+                (unsigned long long) m_lastStateHash, (unsigned long long) m_stateHash.getChain());
+            m_stateHashLog << line;
+        }
         display.draw(w, h);
         m_pressedKeys.clear();
         m_debugger.endLoop();
@@ -110,7 +137,37 @@ double Emulator::getDeltaTime()
 
 void Emulator::reset() {
     //init(); // Only reinitialize components without loading ROM.
+    if (m_memory128K) { m_memory128K->resetPaging(); }
+    m_snapshots.releaseAll();
     loadROM(m_ROMfile);
+    m_stateHash.reset();
+}
+
+uint64_t Emulator::getStateHash() const
+{
+    return m_lastStateHash;
+}
+
+bool Emulator::setStateHashLog(const std::string& filename)
+{
+    if (m_stateHashLog.is_open()) { m_stateHashLog.close(); }
+    if (filename.empty()) { return true; }
+    m_stateHashLog.open(filename);
+    if (!m_stateHashLog) {
+        std::cerr << "Failed to open state hash log." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Emulator::setContention(bool enabled)
+{
+    m_proc.setBusListener(enabled ? m_contention.get() : nullptr);
+}
+
+Snapshots* Emulator::getSnapshots()
+{
+    return &m_snapshots;
 }
 
 Display* Emulator::getDisplay()
@@ -145,7 +202,7 @@ void Emulator::processSDLEvent(SDL_Event e)
 
 Spectrum48KMemory* Emulator::getMemory()
 {
-    return &m_memory;
+    return m_memory;
 }
 
 
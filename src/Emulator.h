@@ -10,14 +10,21 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <fstream>
 #include "ULA.h"
 #include "debugger.h"
+#include "state_hash.h"
+#include "spectrum128k.h"
+#include "contention.h"
+#include "snapshot.h"
+#include <memory>
 
 #define REFRESH_RATE (1.0 / 50.0) // 50Hz refresh rate
 
 class Emulator {
     public:
-        Emulator(SDL_Window* window);
+        // A 128K machine when spectrum128K, loadROM() then expects both ROMs in one 32K image
+        Emulator(SDL_Window* window, bool spectrum128K = false);
 
 
         void loadROM(std::string filename);
@@ -28,6 +35,17 @@ class Emulator {
 
         void reset();
 
+        // Fingerprint of the machine at the end of the last frame, see StateHash
+        uint64_t getStateHash() const;
+        // Write "frame hash chain" for every frame to filename, an empty name
+        // stops logging. Returns false if the file can't be opened.
+        bool setStateHashLog(const std::string& filename);
+
+        // ULA contention, off by default as it runs the CPU one micro-op at a time
+        void setContention(bool enabled);
+
+        // Copy-on-write snapshots of the running machine
+        Snapshots* getSnapshots();
 
 
     Display* getDisplay();
@@ -40,8 +58,13 @@ protected:
     void init();
 
 private:
+    Spectrum48KMemory m_memory48K;
+    std::unique_ptr<Spectrum128KMemory> m_memory128K;   // Only on the 128K
+    Spectrum48KMemory* m_memory;                        // One of the two
+    std::unique_ptr<Spectrum128KPaging> m_paging;
     Z80 m_proc;
-    Spectrum48KMemory m_memory;
+    std::unique_ptr<ULAContention> m_contention;
+    Snapshots m_snapshots;
     Display display;
     Input input;
     Sound sound;
@@ -52,6 +75,9 @@ private:
     std::chrono::time_point<std::chrono::high_resolution_clock> m_prevFrameTime;
     std::vector<SDL_Keycode> m_pressedKeys;
     std::chrono::duration<double> m_delta;
+    StateHash m_stateHash;
+    uint64_t m_lastStateHash;
+    std::ofstream m_stateHashLog;
 
 };
 
@@ -48,6 +48,10 @@ bool Input::isKeyPressed(const std::string& key) const {
     return it != keyState.end() && it->second;
 }
 
+bool Input::isKeyPressed(int row, int col) const {
+    return isKeyPressed(keyStrings[row][col]);
+}
+
 std::string Input::getKeyStringFromSDLKeycode(SDL_Keycode keycode) const {
     for (int i = 0; i < 8; ++i) {
         for (int j = 0; j < 5; ++j) {
@@ -6,11 +6,12 @@
 #include <SDL.h>
 #include "ULA.h"
 
-class Input {
+class Input : public IKeyboard {
 public:
     Input();
     void processSDLEvent(const SDL_Event& event);
     bool isKeyPressed(const std::string& key) const;
+    bool isKeyPressed(int row, int col) const override;
     static std::string getKeyString(int row, int col);
 
 
@@ -2,10 +2,21 @@
 #define MEMORY_H
 
 #include <stdint.h>
+#include <string.h>
+
+// Told before the first write to a 256 byte page of a bank since the last
+// Spectrum48KMemory::snapshotEpoch change, see Snapshots
+class IPageSaver {
+    public:
+        virtual ~IPageSaver() {}
+
+        // page (PAGE_SIZE bytes inside a bank or the sink) is about to change
+        virtual void savePage(uint8_t* page) = 0;
+};
 
 struct Spectrum48KMemory {
-    static const uint16_t MEM_SIZE = 0xBFFF + 1; // 48K Memory
-    uint8_t memory[MEM_SIZE];
+    static const int MEM_SIZE = 0x10000;    // Full 64K address space, 16K ROM and 48K RAM
+    uint8_t memory[MEM_SIZE];               // Backs the default mapping, ROM first
 
     uint8_t* ROM = &memory[0x0000]; // First 16KB is ROM
     uint8_t* screenMemory = &memory[0x4000];
@@ -21,19 +32,282 @@ struct Spectrum48KMemory {
     uint16_t userMemory_size = 0xA28C;
     uint16_t size = 0xFFFF;
 
-     inline uint8_t& operator[](uint16_t i) {
-        // Add bounds checking
-        if (i >= MEM_SIZE) {
-            static uint8_t dummy;
-            // Handle out of bounds memory access, could log an error message or throw an exception
-            return dummy; // Return reference to dummy variable to prevent crash
+    // Writes through operator[] bump the counter of the 256 byte page they land in,
+    // so decoded code can be checked for modification. Writing to memory[] directly
+    // bypasses the counters.
+    static const int PAGE_SHIFT = 8;
+    static const int PAGE_SIZE = 1 << PAGE_SHIFT;
+    static const int NUM_PAGES = 0x10000 >> PAGE_SHIFT;
+    uint32_t pageWrites[NUM_PAGES] = {};
+
+    // 16K page table: each slot of the address space points at the bank it reads
+    // and the one it writes, so an access is a shift, a load and an index with
+    // no branch. ROM slots write into sink.
+    static const int SLOT_SHIFT = 14;
+    static const int SLOT_SIZE = 1 << SLOT_SHIFT;
+    static const int NUM_SLOTS = 0x10000 >> SLOT_SHIFT;
+    uint8_t* readSlots[NUM_SLOTS];
+    uint8_t* writeSlots[NUM_SLOTS];
+    uint8_t sink[SLOT_SIZE];
+
+    // Every bank the slots can map, ROM first, for code that needs the whole
+    // machine rather than what is paged in (see StateHash)
+    static const int MAX_BANKS = 10;
+    uint8_t* banks[MAX_BANKS];
+    int numBanks;
+    uint8_t pagingState = 0;        // Last paging port write of machines that have one
+
+    // Character cells of the shown screen written since clearScreenDirty(), one
+    // bit for each of the 32x24 cells and one for each row of them. A write to
+    // the pixels or the attribute of a cell marks it. Every write pays one
+    // compare against screenMemory, only screen writes do more. There is one
+    // set of bits, the renderer that draws the screen owns clearing them.
+    static const int SCREEN_COLUMNS = 32;
+    static const int SCREEN_ROWS = 24;
+    static const int SCREEN_CELLS = SCREEN_COLUMNS * SCREEN_ROWS;
+    static const int SCREEN_PIXEL_BYTES = 0x1800;
+    static const int SCREEN_BYTES = SCREEN_PIXEL_BYTES + SCREEN_CELLS;
+    uint64_t screenDirty[SCREEN_CELLS / 64];
+    uint32_t screenDirtyRows;
+
+    // Copy-on-write marks: each page of every bank (and of the sink, last)
+    // holds the snapshotEpoch it was last saved in. A write to a page with an
+    // older mark calls pageSaver first. Marks and epoch start equal, so without
+    // snapshots every write passes one compare.
+    static const int BANK_PAGES = SLOT_SIZE >> PAGE_SHIFT;
+    uint32_t pageMarks[MAX_BANKS + 1][BANK_PAGES];
+    uint32_t* readMarks[NUM_SLOTS];             // pageMarks of the banks in readSlots
+    uint32_t* writeMarks[NUM_SLOTS];
+    uint32_t snapshotEpoch = 0;
+    IPageSaver* pageSaver = nullptr;
+
+    // Writes counted per page of every bank (and of the sink, last), so banks
+    // out of the address space can be watched as well. Only good for banks
+    // paged out of every slot: writes to a paged in bank just move pageWrites
+    // and mapSlot adds them to the bank when the slot maps something else.
+    uint32_t bankWrites[MAX_BANKS + 1][BANK_PAGES];
+    uint32_t mappedWrites[NUM_PAGES] = {};      // pageWrites when the slot was mapped
+
+    Spectrum48KMemory()
+    {
+        memset(memory, 0, sizeof(memory));
+        memset(sink, 0, sizeof(sink));
+        memset(pageMarks, 0, sizeof(pageMarks));
+        memset(bankWrites, 0, sizeof(bankWrites));
+        markScreenDirty();
+        numBanks = NUM_SLOTS;
+        for (int slot = 0; slot < NUM_SLOTS; slot++) {
+            banks[slot] = &memory[slot * SLOT_SIZE];
+            readSlots[slot] = writeSlots[slot] = sink;
+        }
+        for (int slot = 0; slot < NUM_SLOTS; slot++) {
+            mapSlot(slot, banks[slot], slot != 0);
+        }
+    }
+
+    // The slots point into this object
+    Spectrum48KMemory(const Spectrum48KMemory&) = delete;
+    Spectrum48KMemory& operator=(const Spectrum48KMemory&) = delete;
+
+    // Map the SLOT_SIZE bytes at bank into slot without copying, writes go to
+    // sink unless writable. Counts a write in every page of the slot when the
+    // mapping changes, so code decoded from the previous bank is dropped.
+    inline void mapSlot(int slot, uint8_t* bank, bool writable)
+    {
+        if (readSlots[slot] == bank && writeSlots[slot] == (writable ? bank : sink)) { return; }
+        // Writes of the slot go to the bank read there, or to the sink when
+        // that's ROM, counting them in the ROM just rehashes it
+        uint32_t* writes = bankWrites[bankIndexOf(readSlots[slot])];
+        for (int page = 0; page < BANK_PAGES; page++) {
+            int p = (slot << (SLOT_SHIFT - PAGE_SHIFT)) + page;
+            writes[page] += pageWrites[p] - mappedWrites[p];
+        }
+        readSlots[slot] = bank;
+        writeSlots[slot] = writable ? bank : sink;
+        readMarks[slot] = pageMarks[bankIndexOf(bank)];
+        writeMarks[slot] = pageMarks[bankIndexOf(writeSlots[slot])];
+        for (int p = slot << (SLOT_SHIFT - PAGE_SHIFT); p < (slot + 1) << (SLOT_SHIFT - PAGE_SHIFT); p++) {
+            pageWrites[p]++;
+            mappedWrites[p] = pageWrites[p];
+        }
+    }
+
+    // Position of bank in banks[], MAX_BANKS for the sink or anything else
+    inline int bankIndexOf(const uint8_t* bank) const
+    {
+        for (int i = 0; i < numBanks; i++)
+        {
+            if (banks[i] == bank) { return i; }
+        }
+        return MAX_BANKS;
+    }
+
+    inline uint8_t read(uint16_t i) const
+    {
+        return readSlots[i >> SLOT_SHIFT][i & (SLOT_SIZE - 1)];
+    }
+
+    inline void write(uint16_t i, uint8_t value)
+    {
+        pageWrites[i >> PAGE_SHIFT]++;
+        uint8_t* p = &writeSlots[i >> SLOT_SHIFT][i & (SLOT_SIZE - 1)];
+        markScreenWrite(p);
+        saveBeforeWrite(writeMarks[i >> SLOT_SHIFT], writeSlots[i >> SLOT_SHIFT], i);
+        *p = value;
+    }
+
+    // Write into the bank i reads from, ROM included. For loaders and tests.
+    inline void poke(uint16_t i, uint8_t value)
+    {
+        pageWrites[i >> PAGE_SHIFT]++;
+        uint8_t* p = &readSlots[i >> SLOT_SHIFT][i & (SLOT_SIZE - 1)];
+        markScreenWrite(p);
+        saveBeforeWrite(readMarks[i >> SLOT_SHIFT], readSlots[i >> SLOT_SHIFT], i);
+        *p = value;
+    }
+
+    // Give pageSaver the page of i in bank unless it was saved this epoch
+    inline void saveBeforeWrite(uint32_t* marks, uint8_t* bank, uint16_t i)
+    {
+        uint32_t& mark = marks[(i & (SLOT_SIZE - 1)) >> PAGE_SHIFT];
+        if (mark == snapshotEpoch) { return; }
+        mark = snapshotEpoch;
+        if (pageSaver) { pageSaver->savePage(bank + (i & (SLOT_SIZE - PAGE_SIZE))); }
+    }
+
+    // Mark the cell of p if it's in the shown screen. Compared in the banks, so
+    // the 128K screen is tracked in whichever slot it's paged.
+    inline void markScreenWrite(const uint8_t* p)
+    {
+        uintptr_t offset = (uintptr_t) p - (uintptr_t) screenMemory;
+        if (offset < SCREEN_BYTES) { markScreenCell(screenCell((int) offset)); }
+    }
+
+    // Cell of a byte of the screen: pixel offsets are laid out as y7 y6, y2 y1
+    // y0, y5 y4 y3, then the column
+    static inline int screenCell(int offset)
+    {
+        if (offset >= SCREEN_PIXEL_BYTES) { return offset - SCREEN_PIXEL_BYTES; }
+        int row = ((offset >> 11) << 3) | ((offset >> 5) & 0x07);
+        return row * SCREEN_COLUMNS + (offset & (SCREEN_COLUMNS - 1));
+    }
+
+    inline void markScreenCell(int cell)
+    {
+        screenDirty[cell >> 6] |= 1ULL << (cell & 63);
+        screenDirtyRows |= 1u << (cell / SCREEN_COLUMNS);
+    }
+
+    inline bool isScreenCellDirty(int cell) const { return (screenDirty[cell >> 6] >> (cell & 63)) & 1; }
+    inline bool isScreenRowDirty(int row) const { return (screenDirtyRows >> row) & 1; }
+    inline bool isScreenDirty() const { return screenDirtyRows != 0; }
+
+    // Everything needs drawing, the screen was switched or loaded behind the counters
+    inline void markScreenDirty()
+    {
+        memset(screenDirty, 0xFF, sizeof(screenDirty));
+        screenDirtyRows = (1u << SCREEN_ROWS) - 1;
+    }
+
+    inline void clearScreenDirty()
+    {
+        memset(screenDirty, 0, sizeof(screenDirty));
+        screenDirtyRows = 0;
+    }
+
+    // Contiguous bytes behind i, valid up to the end of its slot
+    inline const uint8_t* readPointer(uint16_t i) const { return &readSlots[i >> SLOT_SHIFT][i & (SLOT_SIZE - 1)]; }
+    inline uint8_t* writePointer(uint16_t i) { return &writeSlots[i >> SLOT_SHIFT][i & (SLOT_SIZE - 1)]; }
+
+    // Same as count iterations of write(to, read(from)) with both addresses moving
+    // by step (1 or -1) and wrapping at 64K, used by LDIR and LDDR
+    inline void copy(uint16_t to, uint16_t from, int count, int step)
+    {
+        // Lowest addresses of the two spans
+        int toStart = step > 0 ? to : to - count + 1;
+        int fromStart = step > 0 ? from : from - count + 1;
+        // Each span within one slot, so it's contiguous in its bank
+        bool inside = count > 0 && toStart >= 0 && fromStart >= 0 && toStart + count <= MEM_SIZE && fromStart + count <= MEM_SIZE &&
+            toStart >> SLOT_SHIFT == (toStart + count - 1) >> SLOT_SHIFT &&
+            fromStart >> SLOT_SHIFT == (fromStart + count - 1) >> SLOT_SHIFT;
+
+        // Compared in the banks, two slots may map the same one
+        uintptr_t target = inside ? (uintptr_t) writePointer(to) : 0;
+        uintptr_t source = inside ? (uintptr_t) readPointer(from) : 0;
+        // A byte written before it's read repeats the pattern instead of moving it
+        bool rereads = step > 0 ? (source < target && target < source + count) : (target < source && target > source - count);
+
+        if (inside && (!rereads || (intptr_t) (target - source) == step))
+        {
+            for (int p = toStart >> PAGE_SHIFT; p <= (toStart + count - 1) >> PAGE_SHIFT; p++)
+            {
+                saveBeforeWrite(writeMarks[toStart >> SLOT_SHIFT], writeSlots[toStart >> SLOT_SHIFT], (uint16_t) (p << PAGE_SHIFT));
+            }
+            if (rereads) { memset(writePointer((uint16_t) toStart), read(from), count); }
+            else { memmove(writePointer((uint16_t) toStart), readPointer((uint16_t) fromStart), count); }
+            for (int p = toStart >> PAGE_SHIFT; p <= (toStart + count - 1) >> PAGE_SHIFT; p++)
+            {
+                int pageStart = p << PAGE_SHIFT;
+                int first = toStart > pageStart ? toStart : pageStart;
+                int last = toStart + count < pageStart + (1 << PAGE_SHIFT) ? toStart + count : pageStart + (1 << PAGE_SHIFT);
+                pageWrites[p] += last - first;
+            }
+            uintptr_t span = (uintptr_t) writePointer((uint16_t) toStart);
+            uintptr_t screen = (uintptr_t) screenMemory;
+            if (span < screen + SCREEN_BYTES && span + count > screen)
+            {
+                for (int i = 0; i < count; i++) { markScreenWrite((const uint8_t*) span + i); }
+            }
+            return;
         }
-        return memory[i];
+
+        for (int i = 0; i < count; i++)
+        {
+            write(to, read(from));
+            to += step;
+            from += step;
+        }
+    }
+
+    // Count a write in every page, call after loading into memory[] directly
+    inline void touchAll()
+    {
+        for (int p = 0; p < NUM_PAGES; p++) {
+            pageWrites[p]++;
+        }
+        for (int bank = 0; bank < MAX_BANKS; bank++) {
+            for (uint32_t& count : bankWrites[bank]) { count++; }
+        }
+        markScreenDirty();
+    }
+
+    // Reference to a single byte, reads and writes go through read() and write()
+    class Cell {
+        public:
+            Cell(Spectrum48KMemory* memory, uint16_t address) : m_memory(memory), m_address(address) {}
+
+            inline operator uint8_t() const { return m_memory->read(m_address); }
+            inline Cell& operator=(uint8_t value) { m_memory->write(m_address, value); return *this; }
+            inline Cell& operator=(const Cell& other) { return *this = (uint8_t) other; }
+            // int operands truncated to a byte, like the compound assignments of a uint8_t&
+            inline Cell& operator|=(int value) { return *this = (uint8_t) (*this | value); }
+            inline Cell& operator&=(int value) { return *this = (uint8_t) (*this & value); }
+            inline Cell& operator^=(int value) { return *this = (uint8_t) (*this ^ value); }
+            inline Cell& operator+=(int value) { return *this = (uint8_t) (*this + value); }
+            inline Cell& operator-=(int value) { return *this = (uint8_t) (*this - value); }
+
+        private:
+            Spectrum48KMemory* m_memory;
+            uint16_t m_address;
+    };
+
+    inline Cell operator[](uint16_t i) {
+        return Cell(this, i);
     }
 
-    inline const uint8_t& operator[](uint16_t i) const
+    inline uint8_t operator[](uint16_t i) const
     {
-        return memory[i];
+        return read(i);
     }
 
     uint8_t* begin() { return memory; }
@@ -46,4 +320,4 @@ struct Spectrum48KMemory {
 
 };
 
-#endif
\ No newline at end of file
+#endif
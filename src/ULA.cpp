@@ -1,7 +1,6 @@
 #include "ULA.h"
-#include "Input.h"
 
-ULA::ULA(Input* input) : input(input) {
+ULA::ULA(IKeyboard* input) : input(input) {
     // Initialize the keyboard matrix to all keys not pressed
     for (int i = 0; i < 8; ++i) {
         keyboardMatrix[i] = 0xFF; // All bits set to 1
@@ -18,10 +17,8 @@ void ULA::processKeyboardInput() {
 
         // For each key in the row...
         for (int col = 0; col < 5; ++col) {
-            // Use the public method to get the key string
-            std::string keyStr = Input::getKeyString(row, col);
             // Determine if the key is pressed
-            if (input->isKeyPressed(keyStr)) {
+            if (input->isKeyPressed(row, col)) {
                 // Clear the bit for the pressed key
                 keyboardMatrix[row] &= ~(1 << col);
             }
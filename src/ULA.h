@@ -2,16 +2,25 @@
 #define ULA_H
 
 #include <cstdint>
-class Input; 
+
+// Key state read by ULA::processKeyboardInput, implemented by the frontend
+// (Input) so the core doesn't depend on SDL
+class IKeyboard {
+public:
+    virtual ~IKeyboard() {}
+
+    // Key col (0-4) of keyboard matrix row (0-7) is held down
+    virtual bool isKeyPressed(int row, int col) const = 0;
+};
 
 class ULA {
 public:
-    ULA(Input* input);
+    ULA(IKeyboard* input);
     void processKeyboardInput();
     uint8_t readKeyboard(int row);
 
 private:
-    Input* input;
+    IKeyboard* input;
     uint8_t keyboardMatrix[8]; // Assuming 8 rows for the keyboard matrix
 };
 
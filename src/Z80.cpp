@@ -2,81 +2,15 @@
 #include "debugger.h"
 #include "ULA.h"
 
+#include <algorithm>
+#include <cstring>
+
 Z80IOPorts::Z80IOPorts(ULA* ula) : ula(ula) {
 }
 
-int Z80::parseNextInstruction()
+DecodedOpcode Z80::parseNextInstruction()
 {
-    uint16_t location = m_registers.PC;
-    std::vector<uint8_t> bytes;
-
-    int i = 0;
-    // Do not use memory's operator[] to circumvent memory contention emulation
-    while (prefixes.find(m_memory->memory[location]) != prefixes.end())
-    {
-
-        bytes.push_back((*m_memory)[location]);
-        location++;
-        if (bytes.size() >= 2 && i > 0 && 
-              ( (bytes[i-1] == 0xFD && bytes[i] == 0xDD) ||
-                (bytes[i-1] == 0xDD && bytes[i] == 0xFD)
-              )
-           )
-        {
-            // if FD and DD are found one after the other, remove the first one
-            // (not a valid prefix)
-            bytes.erase(bytes.begin() + i - 1);
-        }
-        i++;
-        if (bytes.size() == 2 && ( (bytes[0] == 0xDD || bytes[0] == 0xFD) && bytes[1] == 0xCB ))
-        {
-            // Next byte for DDCB or FDCB is data, not another prefix
-            break;
-        }
-    }
-
-    if (bytes.size() == 2 && ( (bytes[0] == 0xDD || bytes[0] == 0xFD) && bytes[1] == 0xCB ))
-    {
-        // if the prefixes are DDCB or FDCB, then the opcode is in forth byte after displacement byte
-        location++;
-    }
-
-    // In the case of 0xCBCB, 0xCBED, 0xCBDD, 0xCBFD the opcode is already the last byte from "prefixes"
-    if ( !(bytes.size() == 2 && (bytes[0] == 0xCB && bytes[1] == 0xCB)) )
-    if ( !(bytes.size() == 2 && (bytes[0] == 0xCB && bytes[1] == 0xED)) )
-    if ( !(bytes.size() == 2 && (bytes[0] == 0xCB && bytes[1] == 0xDD)) )
-    if ( !(bytes.size() == 2 && (bytes[0] == 0xCB && bytes[1] == 0xFD)) )
-    {
-        bytes.push_back((*m_memory)[location]);
-        if ( bytes.size() > 1 && bytes[1] == 0xED ) { bytes[0] = 0; }     // Ignore other prefixes before ED
-    }
-    
-
-    assert(bytes.size() <= 3);
-
-    while (bytes.size() < 3) { bytes.insert(bytes.begin(), 0); }   // Pad with zeros
-
-    int pref1 = 0;
-    switch (bytes[0])
-    {
-        case 0xDD: pref1 = 1; break;
-        case 0xFD: pref1 = 2; break;
-        case 0xED: pref1 = 3; break;
-        case 0xCB: pref1 = 4; break;
-        default: pref1 = 0; break;
-    }
-    int pref2 = 0;
-    switch (bytes[1])
-    {
-        case 0xDD: pref2 = 1; break;
-        case 0xFD: pref2 = 2; break;
-        case 0xED: pref2 = 3; break;
-        case 0xCB: pref2 = 4; break;
-        default: pref2 = 0; break;
-    }
-
-    // Compute the index in array, more info in instructions_preprocess.py
-    return ((pref1 > 0) ? pref1 + 4 : 0) * 256 + pref2 * 256 + bytes[2];
+    return m_decoder.decode(*m_memory, m_registers.PC);
 }
 
 void Z80::init()
@@ -99,19 +33,36 @@ void Z80::init()
     m_registers.HLx.word = 0xFFFF;
 
     m_cyclesSinceLastFrame = 0;
-
-    m_instructionSet = z80InstructionSet();
+    m_frameStart = 0;
+    m_scheduler.cancelAll();
+    if (m_frameInterruptEnabled) { m_scheduler.schedule(m_frameInterruptId, 0); }
+    m_isHalted = false;
+    m_fastForwardedCycles = 0;
+    m_lastFrameFastForwarded = 0;
+    m_idleSkippedCycles = 0;
+    m_lastFrameIdleSkipped = 0;
+
+    m_instructionTable = &z80InstructionTable();
+    m_instructions = m_instructionTable->hot.data();
+    m_decoder.loadInstructionSet(m_instructionTable->hot);
+    m_blockCache.loadInstructionSet(m_instructions, &m_decoder);
+#ifdef Z80_DYNAREC
+    m_dynarec.clear();
+#endif
 }
 
 Z80::Z80(Spectrum48KMemory* m, ULA* ula, Debugger* debugger)
     : m_memory(m),
       m_ula(ula),
       m_debugger(debugger),
-      m_ioPorts(ula)
+      m_ioPorts(ula),
+      m_frameInterrupt(this)
 {
     logFile.open("emulation_log.txt", std::ios::out | std::ios::trunc);
+    m_frameInterruptId = m_scheduler.addEvent(&m_frameInterrupt);
     init();
     m_cyclesSinceLastFrame = 0;
+    m_debugging = m_debugRequested = debugger != nullptr;
 }
 
 Z80::~Z80() {
@@ -140,6 +91,11 @@ void Z80::setIFF2(bool b)
     m_IFF2 = b;
 }
 
+bool Z80::getIFF1()
+{
+    return m_IFF1;
+}
+
 bool Z80::getIFF2()
 {
     return m_IFF2;
@@ -150,6 +106,11 @@ void Z80::halt()
     m_isHalted = true;
 }
 
+bool Z80::isHalted() const
+{
+    return m_isHalted;
+}
+
 int Z80::getInterruptMode()
 {
     return m_interruptMode;
@@ -160,28 +121,144 @@ void Z80::setInterruptMode(int m)
     m_interruptMode = m;
 }
 
-std::vector<uint8_t> Z80::getInstructionData(Instruction inst, int instIndex, uint16_t PC)
+int Z80::getCyclesSinceLastFrame()
 {
-    std::vector<uint8_t> data;
-    int i = 0;
-    if ( instIndex >= 2304 && instIndex <= 2815 )
+    return m_cyclesSinceLastFrame;
+}
+
+uint64_t Z80::getTStates() const
+{
+    return m_frameStart + m_cyclesSinceLastFrame;
+}
+
+Z80State Z80::saveState() const
+{
+    Z80State state;
+    state.registers = m_registers;
+    state.IFF1 = m_IFF1;
+    state.IFF2 = m_IFF2;
+    state.halted = m_isHalted;
+    state.interruptMode = m_interruptMode;
+    state.frameStart = m_frameStart;
+    state.cyclesSinceLastFrame = m_cyclesSinceLastFrame;
+    state.frameInterruptDeadline = m_scheduler.getDeadline(m_frameInterruptId);
+    return state;
+}
+
+void Z80::loadState(const Z80State& state)
+{
+    m_registers = state.registers;
+    m_IFF1 = state.IFF1;
+    m_IFF2 = state.IFF2;
+    m_isHalted = state.halted;
+    m_interruptMode = state.interruptMode;
+    m_frameStart = state.frameStart;
+    m_cyclesSinceLastFrame = state.cyclesSinceLastFrame;
+    m_scheduler.schedule(m_frameInterruptId, state.frameInterruptDeadline);
+}
+
+Scheduler& Z80::getScheduler()
+{
+    return m_scheduler;
+}
+
+void Z80::setFrameInterrupt(bool enabled)
+{
+    m_frameInterruptEnabled = enabled;
+    // The interrupt of the current frame is still due if nothing has run in it
+    if (enabled)
     {
-        // in DDCB and FDCB instructions, data byte is before opcode
-        i = -1;
+        m_scheduler.schedule(m_frameInterruptId, m_frameStart + (getTStates() > m_frameStart ? m_frameCycles : 0));
     }
-    for (; i < inst.numDataBytes; i++)
+    else
     {
-        data.push_back((*m_memory)[PC + i]);
+        m_scheduler.cancel(m_frameInterruptId);
+    }
+}
+
+void Z80::FrameInterrupt::handleEvent(uint64_t deadline)
+{
+    z->nmi();
+    z->m_scheduler.schedule(z->m_frameInterruptId, deadline + z->m_frameCycles);
+}
+
+int Z80::getFastForwardedCycles() const
+{
+    return m_lastFrameFastForwarded;
+}
+
+int Z80::getIdleSkippedCycles() const
+{
+    return m_lastFrameIdleSkipped;
+}
+
+void Z80::setDebugging(bool enabled)
+{
+    m_debugRequested = enabled;
+}
+
+bool Z80::isDebugging() const
+{
+    return m_debugging;
+}
+
+void Z80::setBlockCacheEnabled(bool enabled)
+{
+    m_blockCacheEnabled = enabled;
+}
+
+const BlockCache::Stats& Z80::getBlockCacheStats() const
+{
+    return m_blockCache.getStats();
+}
+
+void Z80::setSuperinstructionsEnabled(bool enabled)
+{
+    m_blockCache.setSuperinstructionsEnabled(enabled);
+}
+
+void Z80::setBusListener(IBusListener* listener)
+{
+#ifndef Z80_NO_BUS_LISTENER
+    m_busListener = listener;
+#else
+    (void) listener;
+#endif
+}
+
+void Z80::setFrameCycles(int cycles)
+{
+    m_frameCycles = cycles;
+}
+
+int Z80::getFrameCycles() const
+{
+    return m_frameCycles;
+}
+
+#ifdef Z80_DYNAREC
+const Dynarec::Stats& Z80::getDynarecStats() const
+{
+    return m_dynarec.getStats();
+}
+#endif
+
+InstructionData Z80::getInstructionData(int numDataBytes, int dataOffset, uint16_t PC)
+{
+    InstructionData data = {};
+    for (int i = 0; i < numDataBytes - dataOffset; i++)
+    {
+        data.bytes[i] = (*m_memory)[PC + dataOffset + i];
     }
 
     return data;
 }
 
-int Z80::runInstruction(int instBytes)
+int Z80::runInstruction(int instIndex, int dataOffset)
 {
-    Instruction instruction = (*m_instructionSet)[instBytes];
+    const InstructionHot& instruction = m_instructions[instIndex];
 
-    std::vector<uint8_t> data = getInstructionData(instruction, instBytes, m_registers.PC);
+    InstructionData data = getInstructionData(instruction.numDataBytes, dataOffset, m_registers.PC);
 
     m_registers.PC += instruction.numDataBytes;
     auto prevPC = m_registers.PC;
@@ -197,29 +274,298 @@ int Z80::runInstruction(int instBytes)
     return cyclesTaken;
 }
 
-void Z80::nextInstruction()
+int Z80::executeInstruction(DecodedOpcode* decoded)
+{
+    DecodedOpcode opcode = parseNextInstruction();
+    m_registers.PC += opcode.length;
+    if (decoded) { *decoded = opcode; }
+
+    return runInstruction(opcode.index, opcode.dataOffset) + 4 * opcode.ignoredPrefixes;
+}
+
+#ifndef Z80_NO_BUS_LISTENER
+// Address a micro-op accesses, r holds the registers before the instruction
+static uint16_t microOpAddress(const MicroOp& op, const Z80Registers& r, uint16_t pc, InstructionData data)
+{
+    uint16_t address = 0;
+    switch (op.source)
+    {
+        case AddressSource::NONE:       break;
+        case AddressSource::PC:         address = pc; break;
+        case AddressSource::BC:         address = r.BC.word; break;
+        case AddressSource::DE:         address = r.DE.word; break;
+        case AddressSource::HL:         address = r.HL.word; break;
+        case AddressSource::SP:         address = r.SP; break;
+        case AddressSource::IX_D:       address = r.IX.word + (int8_t) data[0]; break;
+        case AddressSource::IY_D:       address = r.IY.word + (int8_t) data[0]; break;
+        case AddressSource::OPERAND:    address = CREATE_WORD(data[0], data[1]); break;
+        case AddressSource::PORT_N:     address = CREATE_WORD(data[0], r.AF.bytes.high); break;
+    }
+    return address + op.offset;
+}
+#endif
+
+int Z80::executeMicroOps(DecodedOpcode* decoded)
 {
-    if (!m_debugger) {
-        std::cerr << "Debugger is not initialized.\n";
+#ifdef Z80_NO_BUS_LISTENER
+    return executeInstruction(decoded);    // no listener to report the cycles to
+#else
+    DecodedOpcode opcode = parseNextInstruction();
+    if (decoded) { *decoded = opcode; }
+
+    const InstructionHot& instruction = m_instructions[opcode.index];
+    const MicroProgram& program = m_instructionTable->micro[opcode.index];
+    const Z80Registers before = m_registers;
+    int start = m_cyclesSinceLastFrame;
+    int waits = 0;
+
+    // Ignored DD/FD prefixes are fetched as NOPs
+    for (int i = 0; i < opcode.ignoredPrefixes; i++)
+    {
+        waits += m_busListener->busCycle(MicroOpType::FETCH, before.PC + i, start + waits, 4);
+        start += 4;
+    }
+    const uint16_t pc = before.PC + opcode.ignoredPrefixes;
+
+    InstructionData data = getInstructionData(instruction.numDataBytes, opcode.dataOffset, before.PC + opcode.length);
+    m_registers.PC += opcode.length + instruction.numDataBytes;
+    const uint16_t nextPC = m_registers.PC;
+    bool jumped = false;
+
+    for (int i = 0; i < program.count; i++)
+    {
+        const MicroOp& op = program.ops[i];
+        if (op.type == MicroOpType::EXECUTE)
+        {
+            instruction.execute(this, m_memory, data);
+            jumped = m_registers.PC != nextPC;
+            if (!jumped) { break; }
+            continue;
+        }
+        const int end = i + 1 < program.count ? program.ops[i + 1].tstate : instruction.cyclesOnJump;
+        waits += m_busListener->busCycle(op.type, microOpAddress(op, before, pc, data), start + op.tstate + waits, end - op.tstate);
+    }
+
+    return (jumped ? instruction.cyclesOnJump : instruction.cycles) + 4 * opcode.ignoredPrefixes + waits;
+#endif
+}
+
+void Z80::runBlock(int cycleLimit)
+{
+    if (m_isHalted && (*m_memory)[m_registers.PC] == 0x76)
+    {
+        m_cyclesSinceLastFrame += runHalt(m_cyclesSinceLastFrame, cycleLimit, m_instructions[0x76].cycles);
         return;
     }
-    std::map<int, Breakpoint>* breakpoints = m_debugger->getBreakpoints();
-      if (!breakpoints) {
-        std::cerr << "Breakpoints map is null.\n";
+
+    const BasicBlock* block = m_blockCache.lookup(*m_memory, m_registers.PC);
+    if (!block)
+    {
+        m_cyclesSinceLastFrame += executeInstruction();
+        return;
+    }
+
+    if (block->repeats)
+    {
+        m_cyclesSinceLastFrame += runRepeated(m_cyclesSinceLastFrame, cycleLimit);
+        m_blockCache.countInstructions(1);
         return;
     }
 
-    //std::cout << "Number of breakpoints: " << breakpoints->size() << std::endl;
+    const int start = m_cyclesSinceLastFrame;
+    Z80Registers before;
+    if (block->idleLoop) { before = m_registers; }
+
+#ifdef Z80_DYNAREC
+    if (DynarecCode code = m_dynarec.lookup(*block, m_blockCache))
+    {
+        DynarecFrame frame;
+        frame.z = this;
+        frame.m = m_memory;
+        frame.registers = &m_registers;
+        frame.pageWrites = &m_memory->pageWrites[block->pc >> Spectrum48KMemory::PAGE_SHIFT];
+        frame.cycleBudget = cycleLimit < m_cyclesSinceLastFrame ? -1 : cycleLimit - m_cyclesSinceLastFrame;
+        frame.superinstructions = 0;
+        frame.fused = 0;
+        m_cyclesSinceLastFrame += code(&frame);
+        m_blockCache.countInstructions(frame.instructions);
+        m_blockCache.countSuperinstructions(frame.superinstructions, frame.fused);
+        m_dynarec.countInstructions(frame.instructions);
+        if (block->idleLoop) { skipIdleLoop(*block, before, start, cycleLimit); }
+        return;
+    }
+#endif
+
+    const uint32_t& pageWrites = m_memory->pageWrites[block->pc >> Spectrum48KMemory::PAGE_SHIFT];
+    int i = 0;
+    while (i < block->count)
+    {
+        const PredecodedInstruction& instruction = block->instructions[i++];
+
+        // The frame can't end inside a superinstruction, so it only runs when
+        // its last instruction would have been reached anyway
+        if (instruction.superinstruction)
+        {
+            const Superinstruction& super = m_blockCache.superinstruction(instruction.superinstruction);
+            if (m_cyclesSinceLastFrame + super.leadCycles <= cycleLimit)
+            {
+                i += super.count - 1;
+                m_registers.PC += super.length;
+                uint16_t nextPC = m_registers.PC;
+
+                super.execute(this, m_memory, block->instructions[i - 1].data);
+                m_blockCache.countSuperinstruction(super.count);
+
+                if (m_registers.PC != nextPC)
+                {
+                    m_cyclesSinceLastFrame += super.cyclesOnJump;
+                    break;
+                }
+                m_cyclesSinceLastFrame += super.cycles;
+
+                if (pageWrites != block->pageWrites || m_cyclesSinceLastFrame > cycleLimit) { break; }
+                continue;
+            }
+        }
+
+        m_registers.PC += instruction.length;
+        uint16_t nextPC = m_registers.PC;
+
+        instruction.execute(this, m_memory, instruction.data);
+
+        if (m_registers.PC != nextPC)       // Jump was taken
+        {
+            m_cyclesSinceLastFrame += instruction.cyclesOnJump;
+            break;
+        }
+        m_cyclesSinceLastFrame += instruction.cycles;
+
+        // Self modifying code, the rest of the block may be stale
+        if (pageWrites != block->pageWrites || m_cyclesSinceLastFrame > cycleLimit) { break; }
+    }
+    m_blockCache.countInstructions(i);
+    if (block->idleLoop) { skipIdleLoop(*block, before, start, cycleLimit); }
+}
+
+void Z80::skipIdleLoop(const BasicBlock& block, const Z80Registers& before, int start, int cycleLimit)
+{
+    // Jumped back with every register as it was: the next iteration reads the
+    // same memory and, until the next event, gets the same answers from the ports
+    if (memcmp(&before, &m_registers, sizeof(Z80Registers)) != 0) { return; }
+
+    int iteration = m_cyclesSinceLastFrame - start;
+    int repeats = m_cyclesSinceLastFrame <= cycleLimit ? (cycleLimit - m_cyclesSinceLastFrame) / iteration : 0;
+    m_cyclesSinceLastFrame += repeats * iteration;
+    m_idleSkippedCycles += repeats * iteration;
+    m_blockCache.countInstructions(repeats * block.count);
+}
+
+int Z80::runHalt(int cycles, int cycleLimit, int haltCycles)
+{
+    // Nothing else runs before the interrupt, which is only taken between frames
+    int repeats = cycles <= cycleLimit ? (cycleLimit - cycles) / haltCycles : 0;
+    m_isHalted = true;
+    m_fastForwardedCycles += repeats * haltCycles;
+    return (repeats + 1) * haltCycles;
+}
+
+// Iterations of CPIR/CPDR starting at hl before the one that stops on a match,
+// at most count
+static int iterationsBeforeMatch(const Spectrum48KMemory& m, uint16_t hl, int step, uint8_t a, int count)
+{
+    // CPDR tests the byte below the one it compared
+    uint16_t address = step > 0 ? hl : hl - 1;
+    if (step > 0)
+    {
+        // memchr one 16K slot at a time, each is contiguous in its bank
+        int searched = 0;
+        while (searched < count)
+        {
+            uint16_t start = (uint16_t) (address + searched);
+            int chunk = std::min(count - searched, Spectrum48KMemory::SLOT_SIZE - (start & (Spectrum48KMemory::SLOT_SIZE - 1)));
+            const uint8_t* bytes = m.readPointer(start);
+            const void* match = memchr(bytes, a, chunk);
+            if (match) { return searched + (int) ((const uint8_t*) match - bytes); }
+            searched += chunk;
+        }
+        return count;
+    }
+    for (int i = 0; i < count; i++, address += step)
+    {
+        if (m.read(address) == a) { return i; }
+    }
+    return count;
+}
+
+// Iterations writing from start before the one that writes address
+static int iterationsBeforeWrite(uint16_t start, int step, uint16_t address)
+{
+    return (uint16_t) (step > 0 ? address - start : start - address);
+}
 
+int Z80::runRepeated(int cycles, int cycleLimit)
+{
+    Z80Registers* r = &m_registers;
+    const uint16_t pc = r->PC;
+    const uint8_t opcode = (*m_memory)[(uint16_t) (pc + 1)];
+    const InstructionHot& instruction = m_instructions[768 + opcode];
+
+    const bool io = opcode & 0x02;                  // INIR, OTIR, INDR, OTDR
+    const bool compare = (opcode & 0x03) == 0x01;   // CPIR, CPDR
+    const bool writes = !compare && (!io || !(opcode & 0x01));
+    const int step = (opcode & 0x08) ? -1 : 1;
+    int remaining = io ? (r->BC.bytes.high ? r->BC.bytes.high : 0x100) : (r->BC.word ? r->BC.word : 0x10000);
+
+    // Iterations that repeat and fit before cycleLimit, the last one is executed
+    // through the instruction table below to get its exact flags and cycles
+    int bulk = cycles <= cycleLimit ? (cycleLimit - cycles) / instruction.cyclesOnJump : 0;
+    bulk = std::min(bulk, remaining - 1);
+
+    // Stop before overwriting the instruction, the next iteration decodes it again
+    if (writes)
+    {
+        uint16_t start = io ? r->HL.word : r->DE.word;
+        bulk = std::min(bulk, iterationsBeforeWrite(start, step, pc));
+        bulk = std::min(bulk, iterationsBeforeWrite(start, step, pc + 1));
+    }
+
+    if (compare)
+    {
+        bulk = iterationsBeforeMatch(*m_memory, r->HL.word, step, r->AF.bytes.high, bulk);
+        r->HL.word += step * bulk;
+        r->BC.word -= bulk;
+    }
+    else if (io)
+    {
+        // Ports can't be done in bulk, still skips decoding and dispatch
+        InstructionData data = {};
+        for (int i = 0; i < bulk; i++)
+        {
+            r->PC += 2;
+            instruction.execute(this, m_memory, data);
+        }
+    }
+    else
+    {
+        m_memory->copy(r->DE.word, r->HL.word, bulk, step);
+        r->HL.word += step * bulk;
+        r->DE.word += step * bulk;
+        r->BC.word -= bulk;
+    }
+
+    return bulk * instruction.cyclesOnJump + executeInstruction();
+}
+
+bool Z80::hitBreakpoint()
+{
+    std::map<int, Breakpoint>* breakpoints = m_debugger->getBreakpoints();
     for (auto it = breakpoints->begin(); it != breakpoints->end(); ++it)
     {
-        // TODO: move to function?
         if ( *(it->second.getEnabled()) && *( it->second.getAddress()) == m_registers.PC )
         {
             if ( (*(it->second.getCondition())) == BreakpointCondition::NONE)
             {
-                m_debugger->breakExecution();
-                break;
+                return true;
             }
             uint16_t conditionValue = conditionToRegisterValue(*(it->second.getCondition()),
                 &m_registers);
@@ -247,49 +593,134 @@ void Z80::nextInstruction()
             }
             if (conditionMet)
             {
-                m_debugger->breakExecution();
-                break;
+                return true;
             }
         }
     }
-    int instruction = parseNextInstruction();
-    int numBytes = ( instruction >= 5*256 ) ? 3 : ( instruction >= 256 ) ? 2 : 1;
-    m_registers.PC += numBytes;
-    int cycles = runInstruction(instruction);
+    return false;
+}
+
+void Z80::addTrace(const DecodedOpcode& opcode)
+{
+    int instruction = opcode.index;
+    int numBytes = opcode.length;
+    InstructionTrace trace;
+    trace.address = m_registers.PC - numBytes;
+    trace.registers = m_registers;
+    trace.IFF1 = m_IFF1;
+    trace.IFF2 = m_IFF2;
+    trace.interruptMode = m_interruptMode;
+    trace.frameCycleNumber = m_cyclesSinceLastFrame;
+    const InstructionHot& inst = m_instructions[instruction];
+    trace.mnemonic = m_instructionTable->cold[instruction].mnemonic;
+    InstructionData data = getInstructionData(inst.numDataBytes, opcode.dataOffset,
+        m_registers.PC - inst.numDataBytes);
+    trace.bytes.assign(data.bytes, data.bytes + inst.numDataBytes - opcode.dataOffset);
+    std::vector<uint8_t> opcodeBytes;
+    for (int i = 0; i < numBytes; ++i)
+    {
+        opcodeBytes.push_back((*m_memory)[m_registers.PC - inst.numDataBytes - numBytes + i]);
+    }
+    trace.opcodeBytes = opcodeBytes;
+    m_debugger->addTrace(trace);
+}
+
+template <class Policy>
+void Z80::step()
+{
+    if (Policy::debug && hitBreakpoint())
+    {
+        m_debugger->breakExecution();
+    }
 
-    if (m_debugger->shouldBreak())
+#ifdef Z80_SWITCH_CORE
+    if (!m_busListener && (!Policy::debug || !m_debugger->shouldBreak()))
+    {
+        // Single step, tracing stays on the instruction table path
+        runSwitchCore(std::numeric_limits<int>::min());
+        return;
+    }
+#else
+    if (m_blockCacheEnabled && !m_busListener && (!Policy::debug || !m_debugger->shouldBreak()))
     {
-        // TODO: move to function?
-        InstructionTrace trace;
-        trace.address = m_registers.PC - numBytes;
-        trace.registers = m_registers;
-        trace.IFF1 = m_IFF1;
-        trace.IFF2 = m_IFF2;
-        trace.interruptMode = m_interruptMode;
-        trace.frameCycleNumber = m_cyclesSinceLastFrame;
-        Instruction inst = (*m_instructionSet)[instruction];
-        trace.mnemonic = inst.mnemonic;
-        trace.bytes = getInstructionData(inst, instruction, m_registers.PC - inst.numDataBytes);
-        std::vector<uint8_t> opcodeBytes;
-        for (int i = 0; i < numBytes; ++i)
+        // Single step, tracing stays on the instruction table path
+        runBlock(std::numeric_limits<int>::min());
+        return;
+    }
+#endif
+
+    DecodedOpcode opcode;
+    int cycles = m_busListener ? executeMicroOps(&opcode) : executeInstruction(&opcode);
+    if (Policy::debug && m_debugger->shouldBreak())
+    {
+        addTrace(opcode);
+    }
+    m_cyclesSinceLastFrame += cycles;
+}
+
+template <class Policy>
+void Z80::run(int cycleLimit)
+{
+    // Without breakpoints, tracing or a bus listener the whole slice runs in the fast cores
+    bool fast = !m_busListener && (!Policy::debug ||
+        (m_debugger->getBreakpointsCount() == 0 && !m_debugger->shouldBreak()));
+#ifdef Z80_SWITCH_CORE
+    if (fast && m_cyclesSinceLastFrame <= cycleLimit)
+    {
+        runSwitchCore(cycleLimit);
+    }
+#else
+    if (fast && m_blockCacheEnabled)
+    {
+        while (m_cyclesSinceLastFrame <= cycleLimit)
         {
-            opcodeBytes.push_back((*m_memory)[m_registers.PC - inst.numDataBytes - numBytes + i]);
+            runBlock(cycleLimit);
         }
-        trace.opcodeBytes = opcodeBytes;
-        m_debugger->addTrace(trace);
     }
+#endif
 
-    m_cyclesSinceLastFrame += cycles;
+    while (m_cyclesSinceLastFrame <= cycleLimit)
+    {
+        step<Policy>();
+    }
+}
 
+void Z80::nextInstruction()
+{
+    if (m_debugging) { step<DebugPolicy>(); } else { step<FastPolicy>(); }
 }
 
-void Z80::simulateFrame()
+void Z80::runSlice(uint64_t tstate)
 {
-    while ( m_cyclesSinceLastFrame <= (1.0/50.0) / CLOCK_TIME )
+    if (getTStates() >= tstate) { return; }
+
+    // The cores stop once the frame cycle count exceeds their limit
+    int cycleLimit = (int) (tstate - m_frameStart) - 1;
+    if (m_debugging) { run<DebugPolicy>(cycleLimit); } else { run<FastPolicy>(cycleLimit); }
+}
+
+void Z80::runUntil(uint64_t tstate)
+{
+    while (getTStates() < tstate)
     {
-        nextInstruction();
+        // Events the last slice reached, then straight on to the next deadline
+        m_scheduler.dispatch(getTStates());
+        runSlice(std::min(tstate, m_scheduler.nextDeadline()));
     }
-    m_cyclesSinceLastFrame = 0;
+}
+
+void Z80::simulateFrame()
+{
+    m_debugging = m_debugRequested && m_debugger;
+    runUntil(m_frameStart + m_frameCycles);
+
+    // The overshoot of the last instruction counts towards the next frame
+    m_frameStart += m_frameCycles;
+    m_cyclesSinceLastFrame -= m_frameCycles;
+    m_lastFrameFastForwarded = m_fastForwardedCycles;
+    m_fastForwardedCycles = 0;
+    m_lastFrameIdleSkipped = m_idleSkippedCycles;
+    m_idleSkippedCycles = 0;
 }
 
 
@@ -310,7 +741,7 @@ void Z80::printState()
     std::cout << " DEx = " << m_registers.DEx.word << " HLx = " << m_registers.HLx.word;
     std::cout << " IX = " << m_registers.IX.word << " IY = " << m_registers.IY.word << std::endl;
 
-    std::cout << "(HL) = " << +(m_memory->memory[m_registers.HL.word]) << std::endl;
+    std::cout << "(HL) = " << +(m_memory->read(m_registers.HL.word)) << std::endl;
 
 }
 
@@ -353,6 +784,12 @@ void Z80::nmi()
 {
     if (!m_IFF1) { return; }
     m_IFF1 = false; m_IFF2 = false;
+    // PC was left on the HALT, the interrupt returns to the instruction after it
+    if (m_isHalted)
+    {
+        m_registers.PC++;
+        m_isHalted = false;
+    }
     int cycles;
     switch(m_interruptMode)
     {
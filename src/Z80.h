@@ -5,6 +5,10 @@
 #include "defines.h"
 #include "Memory.h"
 #include "instructions.h"
+#include "decoder.h"
+#include "block_cache.h"
+#include "dynarec.h"
+#include "scheduler.h"
 #include "devices.h"
 #include "ULA.h"
 
@@ -21,13 +25,13 @@
 #include <array>
 #include <memory>
 #include <fstream>
+#include <limits>
 class Debugger;
 
 typedef std::tuple<uint8_t, uint8_t, uint8_t> opcode;
 
-static const std::set<uint8_t> prefixes = { 0xDD, 0xFD, 0xED, 0xCB };
-
-#define CLOCK_TIME ( 1.0 / 3500000.0 )
+#define CLOCK_FREQUENCY 3500000         // T-states per second
+#define FRAME_RATE 50
 
 struct Word {                   // Endianness dependent!
     uint8_t low;
@@ -127,6 +131,26 @@ class Z80IOPorts {
 };
 
 
+// What the CPU needs to resume from a point, see Z80::saveState
+struct Z80State {
+    Z80Registers registers;
+    bool IFF1;
+    bool IFF2;
+    bool halted;
+    int interruptMode;
+    uint64_t frameStart;
+    int cyclesSinceLastFrame;
+    uint64_t frameInterruptDeadline;        // Scheduler::NEVER when not pending
+};
+
+// Policies the execution loop is compiled for, see Z80::setDebugging
+struct FastPolicy {
+    static const bool debug = false;    // No breakpoint, trace or debugger checks at all
+};
+struct DebugPolicy {
+    static const bool debug = true;
+};
+
 class Z80 {
     friend class Z80Tester;
     public:
@@ -137,12 +161,66 @@ class Z80 {
         Z80IOPorts* getIoPorts();
         void setIFF1(bool b);
         void setIFF2(bool b);
+        bool getIFF1();
         bool getIFF2();
         void halt();
+        bool isHalted() const;
         int getInterruptMode();
         void setInterruptMode(int m);
+        int getCyclesSinceLastFrame();
+        // T-states since power on, never reset between frames
+        uint64_t getTStates() const;
+        // T-states the last frame skipped over while halted
+        int getFastForwardedCycles() const;
+        // T-states the last frame skipped in loops polling memory or ports
+        int getIdleSkippedCycles() const;
         void nextInstruction();
 
+        // Registers, interrupt state, clock and the pending frame interrupt.
+        // Other scheduled events and memory belong to the caller (see Snapshots).
+        Z80State saveState() const;
+        void loadState(const Z80State& state);
+
+        // Check breakpoints and record traces, takes effect at the start of the next
+        // frame. On by default when a debugger was passed to the constructor.
+        void setDebugging(bool enabled);
+        bool isDebugging() const;
+
+        // Run from predecoded basic blocks when not tracing (on by default)
+        void setBlockCacheEnabled(bool enabled);
+        const BlockCache::Stats& getBlockCacheStats() const;
+
+        // Run recurring instruction sequences of a block with one dispatch (on by default)
+        void setSuperinstructionsEnabled(bool enabled);
+
+        // Run every instruction through its micro-ops and report each machine
+        // cycle to listener, which may insert wait states. nullptr (the default)
+        // restores the fast cores. Ignored when built with Z80_NO_BUS_LISTENER.
+        void setBusListener(IBusListener* listener);
+#ifdef Z80_DYNAREC
+        // Hot blocks run as call threaded code (x86-64 hosts only)
+        const Dynarec::Stats& getDynarecStats() const;
+#endif
+
+        static const int FRAME_CYCLES = 69888;     // 312 lines of 224 T-states on the 48K
+
+        // T-states from one frame interrupt to the next, FRAME_CYCLES by default
+        void setFrameCycles(int cycles);
+        int getFrameCycles() const;
+
+        // Run whole instructions until getTStates() reaches tstate. The last one
+        // may end past it, the clock keeps the overshoot. Scheduled events are
+        // handled before the first instruction that starts at or past their deadline.
+        void runUntil(uint64_t tstate);
+
+        // Events on the T-state clock, cancelled by init()
+        Scheduler& getScheduler();
+
+        // Raise the frame interrupt (nmi()) through the scheduler at the start of
+        // every frame, instead of the caller doing it before simulateFrame()
+        void setFrameInterrupt(bool enabled);
+
+        // Run up to the end of the current frame and start the next one
         void simulateFrame();
 
         // Non-maskable interrupt
@@ -150,18 +228,74 @@ class Z80 {
 
         void printState();
     protected:
-        // Parse the next instruction from given memory location
-        int parseNextInstruction();
+        // Decode the instruction at PC
+        DecodedOpcode parseNextInstruction();
 
 
-        std::vector<uint8_t> getInstructionData(Instruction inst, int instIndex, uint16_t PC);
+        // Read the operands, dataOffset is -1 when the DDCB/FDCB displacement comes first
+        InstructionData getInstructionData(int numDataBytes, int dataOffset, uint16_t PC);
+
+        // Decode and execute the instruction at PC through the instruction table,
+        // returns the number of cycles taken
+        int executeInstruction(DecodedOpcode* decoded = nullptr);
+
+        // Same as executeInstruction, stepping through the micro-ops of the
+        // instruction and adding the wait states m_busListener asks for
+        int executeMicroOps(DecodedOpcode* decoded = nullptr);
+
+        // Execute the basic block at PC until a jump is taken, its page is written
+        // or the frame cycle count exceeds cycleLimit
+        void runBlock(int cycleLimit);
+
+        // Execute the HALT at PC and its repetitions up to the point where the frame
+        // cycle count exceeds cycleLimit, without stepping through them. Returns
+        // the cycles taken, at least haltCycles.
+        int runHalt(int cycles, int cycleLimit, int haltCycles);
+
+        // block, an idle loop, was just run once starting at the frame cycle count
+        // start with the registers before. If the iteration left them unchanged,
+        // memory and ports are too, so add the iterations that would complete
+        // before the frame cycle count exceeds cycleLimit without running them.
+        void skipIdleLoop(const BasicBlock& block, const Z80Registers& before, int start, int cycleLimit);
+
+        // LDIR, CPIR, INIR, OTIR, LDDR, CPDR, INDR and OTDR
+        static bool isRepeatedOpcodeED(uint8_t opcode) { return (opcode & 0xF4) == 0xB0; }
+
+        // Execute the repeated block instruction at PC (ED prefix, no ignored
+        // prefixes) for as many iterations as a loop stopping once the frame cycle
+        // count exceeds cycleLimit would. cycles is the frame cycle count so far.
+        // Returns the cycles taken, always executes at least one iteration.
+        int runRepeated(int cycles, int cycleLimit);
+
+        // Execute one instruction
+        template <class Policy> void step();
+
+        // Execute instructions until the frame cycle count exceeds cycleLimit
+        template <class Policy> void run(int cycleLimit);
+
+        // runUntil up to a point with no event in between
+        void runSlice(uint64_t tstate);
+
+        // An enabled breakpoint at PC whose condition holds
+        bool hitBreakpoint();
+
+        // Record the instruction just executed in the debugger trace
+        void addTrace(const DecodedOpcode& opcode);
+
+#ifdef Z80_SWITCH_CORE
+        // Run instructions in the switch core until the frame cycle count exceeds
+        // cycleLimit, always executes at least one instruction
+        void runSwitchCore(int cycleLimit);
+#endif
     private:
         std::ofstream logFile;
-        int runInstruction(int instruction);
+        int runInstruction(int instruction, int dataOffset = 0);
         Spectrum48KMemory* m_memory;
         ULA* m_ula;
         Z80IOPorts m_ioPorts;
         Debugger* m_debugger;
+        bool m_debugging;                           // Policy of the current frame
+        bool m_debugRequested;                      // Policy from the next frame on
         Z80Registers m_registers;
         bool m_IFF1;                   
         bool m_IFF2;
@@ -169,9 +303,40 @@ class Z80 {
         bool m_isWaiting;              
         int m_interruptMode;
 
-        std::shared_ptr<std::array<Instruction, NUM_INSTRUCTIONS>> m_instructionSet;
+        const InstructionTable* m_instructionTable;
+        const InstructionHot* m_instructions;       // m_instructionTable->hot
+        Z80Decoder m_decoder;
+        BlockCache m_blockCache;
+        bool m_blockCacheEnabled = true;
+#ifdef Z80_NO_BUS_LISTENER
+        static constexpr IBusListener* m_busListener = nullptr;    // Compiled out, setBusListener() is ignored
+#else
+        IBusListener* m_busListener = nullptr;
+#endif
+        int m_frameCycles = FRAME_CYCLES;
+#ifdef Z80_DYNAREC
+        Dynarec m_dynarec;
+#endif
+
+        // Interrupt at each frame start, see setFrameInterrupt
+        class FrameInterrupt : public IEventHandler {
+            public:
+                FrameInterrupt(Z80* z) : z(z) {}
+                void handleEvent(uint64_t deadline) override;
+            private:
+                Z80* z;
+        };
+        Scheduler m_scheduler;
+        FrameInterrupt m_frameInterrupt;
+        Scheduler::EventId m_frameInterruptId;
+        bool m_frameInterruptEnabled = false;
 
+        uint64_t m_frameStart;                      // getTStates() when the frame began
         int m_cyclesSinceLastFrame;
+        int m_fastForwardedCycles;                  // Skipped in HALT this frame
+        int m_lastFrameFastForwarded;
+        int m_idleSkippedCycles;                    // Skipped in idle loops this frame
+        int m_lastFrameIdleSkipped;
 };
 
 #endif
\ No newline at end of file
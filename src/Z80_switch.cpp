@@ -0,0 +1,2704 @@
+#include "Z80.h"
+#include "debugger.h"
+#include "utils.h"
+
+// Alternative CPU core with the same semantics as z80InstructionSet(), built
+// with -D Z80_SWITCH_CORE. Unprefixed opcodes are executed inline with the
+// register file copied into a local; prefixed opcodes write the registers
+// back and go through the instruction table. Dispatch uses computed goto on
+// GCC/Clang (unless Z80_NO_COMPUTED_GOTO is defined) and a dense switch elsewhere.
+
+#ifdef Z80_SWITCH_CORE
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(Z80_NO_COMPUTED_GOTO)
+    #define Z80_COMPUTED_GOTO
+#endif
+
+#ifdef Z80_COMPUTED_GOTO
+    #define OPCODE(n)       op_##n:
+    #define END_OPCODE()    if (cycles > cycleLimit) { goto done; } \
+                            goto *dispatch[(*m)[r->PC]];
+#else
+    #define OPCODE(n)       case 0x##n:
+    #define END_OPCODE()    break;
+#endif
+
+void Z80::runSwitchCore(int cycleLimit)
+{
+    Z80Registers registers = m_registers;
+    Z80Registers* r = &registers;
+    Spectrum48KMemory* m = m_memory;
+    int cycles = m_cyclesSinceLastFrame;
+    InstructionData d = {};
+    uint16_t prevPC;
+
+#ifdef Z80_COMPUTED_GOTO
+    static void* const dispatch[256] = {
+        &&op_00, &&op_01, &&op_02, &&op_03, &&op_04, &&op_05, &&op_06, &&op_07,
+        &&op_08, &&op_09, &&op_0A, &&op_0B, &&op_0C, &&op_0D, &&op_0E, &&op_0F,
+        &&op_10, &&op_11, &&op_12, &&op_13, &&op_14, &&op_15, &&op_16, &&op_17,
+        &&op_18, &&op_19, &&op_1A, &&op_1B, &&op_1C, &&op_1D, &&op_1E, &&op_1F,
+        &&op_20, &&op_21, &&op_22, &&op_23, &&op_24, &&op_25, &&op_26, &&op_27,
+        &&op_28, &&op_29, &&op_2A, &&op_2B, &&op_2C, &&op_2D, &&op_2E, &&op_2F,
+        &&op_30, &&op_31, &&op_32, &&op_33, &&op_34, &&op_35, &&op_36, &&op_37,
+        &&op_38, &&op_39, &&op_3A, &&op_3B, &&op_3C, &&op_3D, &&op_3E, &&op_3F,
+        &&op_40, &&op_41, &&op_42, &&op_43, &&op_44, &&op_45, &&op_46, &&op_47,
+        &&op_48, &&op_49, &&op_4A, &&op_4B, &&op_4C, &&op_4D, &&op_4E, &&op_4F,
+        &&op_50, &&op_51, &&op_52, &&op_53, &&op_54, &&op_55, &&op_56, &&op_57,
+        &&op_58, &&op_59, &&op_5A, &&op_5B, &&op_5C, &&op_5D, &&op_5E, &&op_5F,
+        &&op_60, &&op_61, &&op_62, &&op_63, &&op_64, &&op_65, &&op_66, &&op_67,
+        &&op_68, &&op_69, &&op_6A, &&op_6B, &&op_6C, &&op_6D, &&op_6E, &&op_6F,
+        &&op_70, &&op_71, &&op_72, &&op_73, &&op_74, &&op_75, &&op_76, &&op_77,
+        &&op_78, &&op_79, &&op_7A, &&op_7B, &&op_7C, &&op_7D, &&op_7E, &&op_7F,
+        &&op_80, &&op_81, &&op_82, &&op_83, &&op_84, &&op_85, &&op_86, &&op_87,
+        &&op_88, &&op_89, &&op_8A, &&op_8B, &&op_8C, &&op_8D, &&op_8E, &&op_8F,
+        &&op_90, &&op_91, &&op_92, &&op_93, &&op_94, &&op_95, &&op_96, &&op_97,
+        &&op_98, &&op_99, &&op_9A, &&op_9B, &&op_9C, &&op_9D, &&op_9E, &&op_9F,
+        &&op_A0, &&op_A1, &&op_A2, &&op_A3, &&op_A4, &&op_A5, &&op_A6, &&op_A7,
+        &&op_A8, &&op_A9, &&op_AA, &&op_AB, &&op_AC, &&op_AD, &&op_AE, &&op_AF,
+        &&op_B0, &&op_B1, &&op_B2, &&op_B3, &&op_B4, &&op_B5, &&op_B6, &&op_B7,
+        &&op_B8, &&op_B9, &&op_BA, &&op_BB, &&op_BC, &&op_BD, &&op_BE, &&op_BF,
+        &&op_C0, &&op_C1, &&op_C2, &&op_C3, &&op_C4, &&op_C5, &&op_C6, &&op_C7,
+        &&op_C8, &&op_C9, &&op_CA, &&op_CB, &&op_CC, &&op_CD, &&op_CE, &&op_CF,
+        &&op_D0, &&op_D1, &&op_D2, &&op_D3, &&op_D4, &&op_D5, &&op_D6, &&op_D7,
+        &&op_D8, &&op_D9, &&op_DA, &&op_DB, &&op_DC, &&op_DD, &&op_DE, &&op_DF,
+        &&op_E0, &&op_E1, &&op_E2, &&op_E3, &&op_E4, &&op_E5, &&op_E6, &&op_E7,
+        &&op_E8, &&op_E9, &&op_EA, &&op_EB, &&op_EC, &&op_ED, &&op_EE, &&op_EF,
+        &&op_F0, &&op_F1, &&op_F2, &&op_F3, &&op_F4, &&op_F5, &&op_F6, &&op_F7,
+        &&op_F8, &&op_F9, &&op_FA, &&op_FB, &&op_FC, &&op_FD, &&op_FE, &&op_FF,
+    };
+
+    goto *dispatch[(*m)[r->PC]];
+    {
+#else
+    for (;;)
+    {
+        switch ((*m)[r->PC])
+        {
+#endif
+
+        // NOP
+        OPCODE(00)
+        {
+            r->PC += 1;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD BC,nn
+        OPCODE(01)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            r->BC.word = CREATE_WORD(d[0], d[1]);
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // LD (BC),A
+        OPCODE(02)
+        {
+            r->PC += 1;
+            (*m)[r->BC.word] = r->AF.bytes.high;
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // INC BC
+        OPCODE(03)
+        {
+            r->PC += 1;
+            r->BC.word = add<uint16_t>(r->BC.word, 1, r, INC16);
+            cycles += 6;
+        }
+        END_OPCODE()
+
+        // INC B
+        OPCODE(04)
+        {
+            r->PC += 1;
+            r->BC.bytes.high = inc8(r->BC.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // DEC B
+        OPCODE(05)
+        {
+            r->PC += 1;
+            r->BC.bytes.high = dec8(r->BC.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD B,n
+        OPCODE(06)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->BC.bytes.high = d[0];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RLCA
+        OPCODE(07)
+        {
+            r->PC += 1;
+            r->AF.bytes.low.CF = (bool)((r->AF.bytes.high >> 7) & 0x01);
+            r->AF.bytes.high = rol<uint8_t>(r->AF.bytes.high);
+            r->AF.bytes.low.NF = false;
+            r->AF.bytes.low.HF = false;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // EX AF, AF'
+        OPCODE(08)
+        {
+            r->PC += 1;
+            uint16_t tmp = r->AFx.word;
+            r->AFx.word = r->AF.word;
+            r->AF.word = tmp;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADD HL,BC
+        OPCODE(09)
+        {
+            r->PC += 1;
+            r->HL.word = add(r->HL.word, r->BC.word, r, ADD16);
+            setUndocumentedFlags(r->HL.word, r);
+            r->AF.bytes.low.NF = false;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // LD A,(BC)
+        OPCODE(0A)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = (*m)[r->BC.word];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // DEC BC
+        OPCODE(0B)
+        {
+            r->PC += 1;
+            r->BC.word = add<uint16_t>(r->BC.word, -1, r, DEC16);
+            cycles += 6;
+        }
+        END_OPCODE()
+
+        // INC C
+        OPCODE(0C)
+        {
+            r->PC += 1;
+            r->BC.bytes.low = inc8(r->BC.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // DEC C
+        OPCODE(0D)
+        {
+            r->PC += 1;
+            r->BC.bytes.low = dec8(r->BC.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD C,n
+        OPCODE(0E)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->BC.bytes.low = d[0];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RRCA
+        OPCODE(0F)
+        {
+            r->PC += 1;
+            r->AF.bytes.low.CF = (bool)((r->AF.bytes.high) & 0x01);
+            r->AF.bytes.high = ror<uint8_t>(r->AF.bytes.high);
+            r->AF.bytes.low.NF = false;
+            r->AF.bytes.low.HF = false;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // DJNZ d
+        OPCODE(10)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            prevPC = r->PC;
+            r->BC.bytes.high = add<uint8_t>(r->BC.bytes.high, -1, r, 0);
+            if (r->BC.bytes.high != 0)
+            {
+                r->PC += (int8_t) d[0];
+            }
+            cycles += (r->PC != prevPC) ? 13 : 8;
+        }
+        END_OPCODE()
+
+        // LD DE,nn
+        OPCODE(11)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            r->DE.word = CREATE_WORD(d[0], d[1]);
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // LD (DE),A
+        OPCODE(12)
+        {
+            r->PC += 1;
+            (*m)[r->DE.word] = r->AF.bytes.high;
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // INC DE
+        OPCODE(13)
+        {
+            r->PC += 1;
+            r->DE.word = add<uint16_t>(r->DE.word, 1, r, INC16);
+            cycles += 6;
+        }
+        END_OPCODE()
+
+        // INC D
+        OPCODE(14)
+        {
+            r->PC += 1;
+            r->DE.bytes.high = inc8(r->DE.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // DEC D
+        OPCODE(15)
+        {
+            r->PC += 1;
+            r->DE.bytes.high = dec8(r->DE.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD D,n
+        OPCODE(16)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->DE.bytes.high = d[0];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RLA
+        OPCODE(17)
+        {
+            r->PC += 1;
+            r->AF.bytes.low.CF = rolc(r->AF.bytes.high, r->AF.bytes.low.CF);
+            r->AF.bytes.low.HF = false;
+            r->AF.bytes.low.NF = false;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // JR d
+        OPCODE(18)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->PC += (int8_t) d[0];
+            cycles += 12;
+        }
+        END_OPCODE()
+
+        // ADD HL,DE
+        OPCODE(19)
+        {
+            r->PC += 1;
+            r->HL.word = add(r->HL.word, r->DE.word, r, ADD16);
+            setUndocumentedFlags(r->HL.word, r);
+            r->AF.bytes.low.NF = false;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // LD A,(DE)
+        OPCODE(1A)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = (*m)[r->DE.word];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // DEC DE
+        OPCODE(1B)
+        {
+            r->PC += 1;
+            r->DE.word = add<uint16_t>(r->DE.word, -1, r, DEC16);
+            cycles += 6;
+        }
+        END_OPCODE()
+
+        // INC E
+        OPCODE(1C)
+        {
+            r->PC += 1;
+            r->DE.bytes.low = inc8(r->DE.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // DEC E
+        OPCODE(1D)
+        {
+            r->PC += 1;
+            r->DE.bytes.low = dec8(r->DE.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD E,n
+        OPCODE(1E)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->DE.bytes.low = d[0];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RRA
+        OPCODE(1F)
+        {
+            r->PC += 1;
+            r->AF.bytes.low.CF = rorc(r->AF.bytes.high, r->AF.bytes.low.CF);
+            r->AF.bytes.low.HF = false;
+            r->AF.bytes.low.NF = false;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // JR NZ,d
+        OPCODE(20)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            prevPC = r->PC;
+            if (r->AF.bytes.low.ZF == false)
+            {
+                r->PC += (int8_t) d[0];
+            }
+            cycles += (r->PC != prevPC) ? 12 : 7;
+        }
+        END_OPCODE()
+
+        // LD HL,nn
+        OPCODE(21)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            r->HL.word = CREATE_WORD(d[0], d[1]);
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // LD (nn),HL
+        OPCODE(22)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            (*m)[nn] = r->HL.bytes.low;
+            (*m)[nn+1] = r->HL.bytes.high;
+            cycles += 16;
+        }
+        END_OPCODE()
+
+        // INC HL
+        OPCODE(23)
+        {
+            r->PC += 1;
+            r->HL.word = add<uint16_t>(r->HL.word, 1, r, INC16);
+            cycles += 6;
+        }
+        END_OPCODE()
+
+        // INC H
+        OPCODE(24)
+        {
+            r->PC += 1;
+            r->HL.bytes.high = inc8(r->HL.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // DEC H
+        OPCODE(25)
+        {
+            r->PC += 1;
+            r->HL.bytes.high = dec8(r->HL.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD H,n
+        OPCODE(26)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->HL.bytes.high = d[0];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // DAA
+        OPCODE(27)
+        {
+            r->PC += 1;
+            daa(r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // JR Z,d
+        OPCODE(28)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            prevPC = r->PC;
+            if (r->AF.bytes.low.ZF == true)
+            {
+                r->PC += (int8_t) d[0];
+            }
+            cycles += (r->PC != prevPC) ? 12 : 7;
+        }
+        END_OPCODE()
+
+        // ADD HL,HL
+        OPCODE(29)
+        {
+            r->PC += 1;
+            r->HL.word = add(r->HL.word, r->HL.word, r, ADD16);
+            setUndocumentedFlags(r->HL.word, r);
+            r->AF.bytes.low.NF = false;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // LD HL,(nn)
+        OPCODE(2A)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            uint16_t in = CREATE_WORD((*m)[nn], (*m)[nn+1]);
+            r->HL.word = in;
+            cycles += 16;
+        }
+        END_OPCODE()
+
+        // DEC HL
+        OPCODE(2B)
+        {
+            r->PC += 1;
+            r->HL.word = add<uint16_t>(r->HL.word, -1, r, DEC16);
+            cycles += 6;
+        }
+        END_OPCODE()
+
+        // INC L
+        OPCODE(2C)
+        {
+            r->PC += 1;
+            r->HL.bytes.low = inc8(r->HL.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // DEC L
+        OPCODE(2D)
+        {
+            r->PC += 1;
+            r->HL.bytes.low = dec8(r->HL.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD L,n
+        OPCODE(2E)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->HL.bytes.low = d[0];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // CPL
+        OPCODE(2F)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = ~(r->AF.bytes.high);
+            r->AF.bytes.low.HF = true;
+            r->AF.bytes.low.NF = true;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // JR NC,d
+        OPCODE(30)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            prevPC = r->PC;
+            if (r->AF.bytes.low.CF == false)
+            {
+                r->PC += (int8_t) d[0];
+            }
+            cycles += (r->PC != prevPC) ? 12 : 7;
+        }
+        END_OPCODE()
+
+        // LD SP,nn
+        OPCODE(31)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            r->SP = CREATE_WORD(d[0], d[1]);
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // LD (nn),A
+        OPCODE(32)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            (*m)[nn] = r->AF.bytes.high;
+            cycles += 13;
+        }
+        END_OPCODE()
+
+        // INC SP
+        OPCODE(33)
+        {
+            r->PC += 1;
+            r->SP = add<uint16_t>(r->SP, 1, r, INC16);
+            cycles += 6;
+        }
+        END_OPCODE()
+
+        // INC (HL)
+        OPCODE(34)
+        {
+            r->PC += 1;
+            uint8_t byte = (*m)[r->HL.word];
+            byte = inc8(byte, r);
+            (*m)[r->HL.word] = byte;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // DEC (HL)
+        OPCODE(35)
+        {
+            r->PC += 1;
+            uint8_t byte = (*m)[r->HL.word];
+            byte = dec8(byte, r);
+            (*m)[r->HL.word] = byte;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // LD (HL),n
+        OPCODE(36)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            (*m)[r->HL.word] = d[0];
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // SCF
+        OPCODE(37)
+        {
+            r->PC += 1;
+            r->AF.bytes.low.CF = true;
+            r->AF.bytes.low.NF = false;
+            r->AF.bytes.low.HF = false;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // JR C,d
+        OPCODE(38)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            prevPC = r->PC;
+            if (r->AF.bytes.low.CF == true)
+            {
+                r->PC += (int8_t) d[0];
+            }
+            cycles += (r->PC != prevPC) ? 12 : 7;
+        }
+        END_OPCODE()
+
+        // ADD HL,SP
+        OPCODE(39)
+        {
+            r->PC += 1;
+            r->HL.word = add(r->HL.word, r->SP, r, ADD16);
+            setUndocumentedFlags(r->HL.word, r);
+            r->AF.bytes.low.NF = false;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // LD A,(nn)
+        OPCODE(3A)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            r->AF.bytes.high = (*m)[nn];
+            cycles += 13;
+        }
+        END_OPCODE()
+
+        // DEC SP
+        OPCODE(3B)
+        {
+            r->PC += 1;
+            r->SP = add<uint16_t>(r->SP, -1, r, DEC16);
+            cycles += 6;
+        }
+        END_OPCODE()
+
+        // INC A
+        OPCODE(3C)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = inc8(r->AF.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // DEC A
+        OPCODE(3D)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = dec8(r->AF.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD A,n
+        OPCODE(3E)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->AF.bytes.high = d[0];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // CCF
+        OPCODE(3F)
+        {
+            r->PC += 1;
+            bool prevCarry = r->AF.bytes.low.CF;
+            r->AF.bytes.low.CF = (r->AF.bytes.low.CF) ? false : true;
+            r->AF.bytes.low.NF = false;
+            r->AF.bytes.low.HF = prevCarry;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD B,B
+        OPCODE(40)
+        {
+            r->PC += 1;
+            ; /* Practically a NOP */
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD B,C
+        OPCODE(41)
+        {
+            r->PC += 1;
+            r->BC.bytes.high = r->BC.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD B,D
+        OPCODE(42)
+        {
+            r->PC += 1;
+            r->BC.bytes.high = r->DE.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD B,E
+        OPCODE(43)
+        {
+            r->PC += 1;
+            r->BC.bytes.high = r->DE.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD B,H
+        OPCODE(44)
+        {
+            r->PC += 1;
+            r->BC.bytes.high = r->HL.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD B,L
+        OPCODE(45)
+        {
+            r->PC += 1;
+            r->BC.bytes.high = r->HL.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD B,(HL)
+        OPCODE(46)
+        {
+            r->PC += 1;
+            r->BC.bytes.high = (*m)[r->HL.word];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD B,A
+        OPCODE(47)
+        {
+            r->PC += 1;
+            r->BC.bytes.high = r->AF.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD C,B
+        OPCODE(48)
+        {
+            r->PC += 1;
+            r->BC.bytes.low = r->BC.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD C,C
+        OPCODE(49)
+        {
+            r->PC += 1;
+            ; /* Practically a NOP */
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD C,D
+        OPCODE(4A)
+        {
+            r->PC += 1;
+            r->BC.bytes.low = r->DE.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD C,E
+        OPCODE(4B)
+        {
+            r->PC += 1;
+            r->BC.bytes.low = r->DE.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD C,H
+        OPCODE(4C)
+        {
+            r->PC += 1;
+            r->BC.bytes.low = r->HL.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD C,L
+        OPCODE(4D)
+        {
+            r->PC += 1;
+            r->BC.bytes.low = r->HL.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD C,(HL)
+        OPCODE(4E)
+        {
+            r->PC += 1;
+            r->BC.bytes.low = (*m)[r->HL.word];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD C,A
+        OPCODE(4F)
+        {
+            r->PC += 1;
+            r->BC.bytes.low = r->AF.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD D,B
+        OPCODE(50)
+        {
+            r->PC += 1;
+            r->DE.bytes.high = r->BC.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD D,C
+        OPCODE(51)
+        {
+            r->PC += 1;
+            r->DE.bytes.high = r->BC.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD D,D
+        OPCODE(52)
+        {
+            r->PC += 1;
+            ; /* Practically a NOP */
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD D,E
+        OPCODE(53)
+        {
+            r->PC += 1;
+            r->DE.bytes.high = r->DE.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD D,H
+        OPCODE(54)
+        {
+            r->PC += 1;
+            r->DE.bytes.high = r->HL.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD D,L
+        OPCODE(55)
+        {
+            r->PC += 1;
+            r->DE.bytes.high = r->HL.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD D,(HL)
+        OPCODE(56)
+        {
+            r->PC += 1;
+            r->DE.bytes.high = (*m)[r->HL.word];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD D,A
+        OPCODE(57)
+        {
+            r->PC += 1;
+            r->DE.bytes.high = r->AF.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD E,B
+        OPCODE(58)
+        {
+            r->PC += 1;
+            r->DE.bytes.low = r->BC.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD E,C
+        OPCODE(59)
+        {
+            r->PC += 1;
+            r->DE.bytes.low = r->BC.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD E,D
+        OPCODE(5A)
+        {
+            r->PC += 1;
+            r->DE.bytes.low = r->DE.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD E,E
+        OPCODE(5B)
+        {
+            r->PC += 1;
+            ; /* Practically a NOP */
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD E,H
+        OPCODE(5C)
+        {
+            r->PC += 1;
+            r->DE.bytes.low = r->HL.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD E,L
+        OPCODE(5D)
+        {
+            r->PC += 1;
+            r->DE.bytes.low = r->HL.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD E,(HL)
+        OPCODE(5E)
+        {
+            r->PC += 1;
+            r->DE.bytes.low = (*m)[r->HL.word];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD E,A
+        OPCODE(5F)
+        {
+            r->PC += 1;
+            r->DE.bytes.low = r->AF.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD H,B
+        OPCODE(60)
+        {
+            r->PC += 1;
+            r->HL.bytes.high = r->BC.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD H,C
+        OPCODE(61)
+        {
+            r->PC += 1;
+            r->HL.bytes.high = r->BC.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD H,D
+        OPCODE(62)
+        {
+            r->PC += 1;
+            r->HL.bytes.high = r->DE.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD H,E
+        OPCODE(63)
+        {
+            r->PC += 1;
+            r->HL.bytes.high = r->DE.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD H,H
+        OPCODE(64)
+        {
+            r->PC += 1;
+            ; /* Practically a NOP */
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD H,L
+        OPCODE(65)
+        {
+            r->PC += 1;
+            r->HL.bytes.high = r->HL.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD H,(HL)
+        OPCODE(66)
+        {
+            r->PC += 1;
+            r->HL.bytes.high = (*m)[r->HL.word];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD H,A
+        OPCODE(67)
+        {
+            r->PC += 1;
+            r->HL.bytes.high = r->AF.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD L,B
+        OPCODE(68)
+        {
+            r->PC += 1;
+            r->HL.bytes.low = r->BC.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD L,C
+        OPCODE(69)
+        {
+            r->PC += 1;
+            r->HL.bytes.low = r->BC.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD L,D
+        OPCODE(6A)
+        {
+            r->PC += 1;
+            r->HL.bytes.low = r->DE.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD L,E
+        OPCODE(6B)
+        {
+            r->PC += 1;
+            r->HL.bytes.low = r->DE.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD L,H
+        OPCODE(6C)
+        {
+            r->PC += 1;
+            r->HL.bytes.low = r->HL.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD L,L
+        OPCODE(6D)
+        {
+            r->PC += 1;
+            ; /* Practically a NOP */
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD L,(HL)
+        OPCODE(6E)
+        {
+            r->PC += 1;
+            r->HL.bytes.low = (*m)[r->HL.word];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD L,A
+        OPCODE(6F)
+        {
+            r->PC += 1;
+            r->HL.bytes.low = r->AF.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD (HL),B
+        OPCODE(70)
+        {
+            r->PC += 1;
+            (*m)[r->HL.word] = r->BC.bytes.high;
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD (HL),C
+        OPCODE(71)
+        {
+            r->PC += 1;
+            (*m)[r->HL.word] = r->BC.bytes.low;
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD (HL),D
+        OPCODE(72)
+        {
+            r->PC += 1;
+            (*m)[r->HL.word] = r->DE.bytes.high;
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD (HL),E
+        OPCODE(73)
+        {
+            r->PC += 1;
+            (*m)[r->HL.word] = r->DE.bytes.low;
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD (HL),H
+        OPCODE(74)
+        {
+            r->PC += 1;
+            (*m)[r->HL.word] = r->HL.bytes.high;
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD (HL),L
+        OPCODE(75)
+        {
+            r->PC += 1;
+            (*m)[r->HL.word] = r->HL.bytes.low;
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // HALT
+        OPCODE(76)
+        {
+            // PC stays on the HALT until the interrupt
+            cycles += runHalt(cycles, cycleLimit, 4);
+        }
+        END_OPCODE()
+
+        // LD (HL),A
+        OPCODE(77)
+        {
+            r->PC += 1;
+            (*m)[r->HL.word] = r->AF.bytes.high;
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD A,B
+        OPCODE(78)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = r->BC.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD A,C
+        OPCODE(79)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = r->BC.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD A,D
+        OPCODE(7A)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = r->DE.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD A,E
+        OPCODE(7B)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = r->DE.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD A,H
+        OPCODE(7C)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = r->HL.bytes.high;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD A,L
+        OPCODE(7D)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = r->HL.bytes.low;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // LD A,(HL)
+        OPCODE(7E)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = (*m)[r->HL.word];
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // LD A,A
+        OPCODE(7F)
+        {
+            r->PC += 1;
+            ; /* Practically a NOP */
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADD A,B
+        OPCODE(80)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = add8(r->AF.bytes.high, r->BC.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADD A,C
+        OPCODE(81)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = add8(r->AF.bytes.high, r->BC.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADD A,D
+        OPCODE(82)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = add8(r->AF.bytes.high, r->DE.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADD A,E
+        OPCODE(83)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = add8(r->AF.bytes.high, r->DE.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADD A,H
+        OPCODE(84)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = add8(r->AF.bytes.high, r->HL.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADD A,L
+        OPCODE(85)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = add8(r->AF.bytes.high, r->HL.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADD A,(HL)
+        OPCODE(86)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = add8(r->AF.bytes.high, (*m)[r->HL.word], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // ADD A,A
+        OPCODE(87)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = add8(r->AF.bytes.high, r->AF.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADC A,B
+        OPCODE(88)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = adc8(r->AF.bytes.high, r->BC.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADC A,C
+        OPCODE(89)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = adc8(r->AF.bytes.high, r->BC.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADC A,D
+        OPCODE(8A)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = adc8(r->AF.bytes.high, r->DE.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADC A,E
+        OPCODE(8B)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = adc8(r->AF.bytes.high, r->DE.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADC A,H
+        OPCODE(8C)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = adc8(r->AF.bytes.high, r->HL.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADC A,L
+        OPCODE(8D)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = adc8(r->AF.bytes.high, r->HL.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // ADC A,(HL)
+        OPCODE(8E)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = adc8(r->AF.bytes.high, (*m)[r->HL.word], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // ADC A,A
+        OPCODE(8F)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = adc8(r->AF.bytes.high, r->AF.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SUB B
+        OPCODE(90)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sub8(r->AF.bytes.high, -(r->BC.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SUB C
+        OPCODE(91)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sub8(r->AF.bytes.high, -(r->BC.bytes.low), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SUB D
+        OPCODE(92)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sub8(r->AF.bytes.high, -(r->DE.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SUB E
+        OPCODE(93)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sub8(r->AF.bytes.high, -(r->DE.bytes.low), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SUB H
+        OPCODE(94)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sub8(r->AF.bytes.high, -(r->HL.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SUB L
+        OPCODE(95)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sub8(r->AF.bytes.high, -(r->HL.bytes.low), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SUB (HL)
+        OPCODE(96)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sub8(r->AF.bytes.high, -((*m)[r->HL.word]), r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // SUB A
+        OPCODE(97)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sub8(r->AF.bytes.high, -(r->AF.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SBC A,B
+        OPCODE(98)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sbc8(r->AF.bytes.high, -(r->BC.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SBC A,C
+        OPCODE(99)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sbc8(r->AF.bytes.high, -(r->BC.bytes.low), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SBC A,D
+        OPCODE(9A)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sbc8(r->AF.bytes.high, -(r->DE.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SBC A,E
+        OPCODE(9B)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sbc8(r->AF.bytes.high, -(r->DE.bytes.low), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SBC A,H
+        OPCODE(9C)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sbc8(r->AF.bytes.high, -(r->HL.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SBC A,L
+        OPCODE(9D)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sbc8(r->AF.bytes.high, -(r->HL.bytes.low), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // SBC A,(HL)
+        OPCODE(9E)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sbc8(r->AF.bytes.high, -((*m)[r->HL.word]), r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // SBC A,A
+        OPCODE(9F)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = sbc8(r->AF.bytes.high, -(r->AF.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // AND B
+        OPCODE(A0)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = and8(r->AF.bytes.high, r->BC.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // AND C
+        OPCODE(A1)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = and8(r->AF.bytes.high, r->BC.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // AND D
+        OPCODE(A2)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = and8(r->AF.bytes.high, r->DE.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // AND E
+        OPCODE(A3)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = and8(r->AF.bytes.high, r->DE.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // AND H
+        OPCODE(A4)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = and8(r->AF.bytes.high, r->HL.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // AND L
+        OPCODE(A5)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = and8(r->AF.bytes.high, r->HL.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // AND (HL)
+        OPCODE(A6)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = and8(r->AF.bytes.high, (*m)[r->HL.word], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // AND A
+        OPCODE(A7)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = and8(r->AF.bytes.high, r->AF.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // XOR B
+        OPCODE(A8)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = xor8(r->AF.bytes.high, r->BC.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // XOR C
+        OPCODE(A9)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = xor8(r->AF.bytes.high, r->BC.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // XOR D
+        OPCODE(AA)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = xor8(r->AF.bytes.high, r->DE.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // XOR E
+        OPCODE(AB)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = xor8(r->AF.bytes.high, r->DE.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // XOR H
+        OPCODE(AC)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = xor8(r->AF.bytes.high, r->HL.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // XOR L
+        OPCODE(AD)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = xor8(r->AF.bytes.high, r->HL.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // XOR (HL)
+        OPCODE(AE)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = xor8(r->AF.bytes.high, (*m)[r->HL.word], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // XOR A
+        OPCODE(AF)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = xor8(r->AF.bytes.high, r->AF.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // OR B
+        OPCODE(B0)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = or8(r->AF.bytes.high, r->BC.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // OR C
+        OPCODE(B1)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = or8(r->AF.bytes.high, r->BC.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // OR D
+        OPCODE(B2)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = or8(r->AF.bytes.high, r->DE.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // OR E
+        OPCODE(B3)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = or8(r->AF.bytes.high, r->DE.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // OR H
+        OPCODE(B4)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = or8(r->AF.bytes.high, r->HL.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // OR L
+        OPCODE(B5)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = or8(r->AF.bytes.high, r->HL.bytes.low, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // OR (HL)
+        OPCODE(B6)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = or8(r->AF.bytes.high, (*m)[r->HL.word], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // OR A
+        OPCODE(B7)
+        {
+            r->PC += 1;
+            r->AF.bytes.high = or8(r->AF.bytes.high, r->AF.bytes.high, r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CP B
+        OPCODE(B8)
+        {
+            r->PC += 1;
+            sub8(r->AF.bytes.high, -(r->BC.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CP C
+        OPCODE(B9)
+        {
+            r->PC += 1;
+            sub8(r->AF.bytes.high, -(r->BC.bytes.low), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CP D
+        OPCODE(BA)
+        {
+            r->PC += 1;
+            sub8(r->AF.bytes.high, -(r->DE.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CP E
+        OPCODE(BB)
+        {
+            r->PC += 1;
+            sub8(r->AF.bytes.high, -(r->DE.bytes.low), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CP H
+        OPCODE(BC)
+        {
+            r->PC += 1;
+            sub8(r->AF.bytes.high, -(r->HL.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CP L
+        OPCODE(BD)
+        {
+            r->PC += 1;
+            sub8(r->AF.bytes.high, -(r->HL.bytes.low), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CP (HL)
+        OPCODE(BE)
+        {
+            r->PC += 1;
+            sub8(r->AF.bytes.high, -((*m)[r->HL.word]), r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // CP A
+        OPCODE(BF)
+        {
+            r->PC += 1;
+            sub8(r->AF.bytes.high, -(r->AF.bytes.high), r);
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // RET NZ
+        OPCODE(C0)
+        {
+            r->PC += 1;
+            prevPC = r->PC;
+            retc(r, m, RetCondition::NZ);
+            cycles += (r->PC != prevPC) ? 11 : 5;
+        }
+        END_OPCODE()
+
+        // POP BC
+        OPCODE(C1)
+        {
+            r->PC += 1;
+            uint8_t low = (*m)[r->SP++];
+            uint8_t high = (*m)[r->SP++];
+            r->BC.word = CREATE_WORD(low, high);
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // JP NZ,nn
+        OPCODE(C2)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            if (!(r->AF.bytes.low.ZF))
+            {
+                r->PC = nn;
+            }
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // JP nn
+        OPCODE(C3)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            r->PC = nn;
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // CALL NZ,nn
+        OPCODE(C4)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            prevPC = r->PC;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            callc(r, m, RetCondition::NZ, nn);
+            cycles += (r->PC != prevPC) ? 17 : 10;
+        }
+        END_OPCODE()
+
+        // PUSH BC
+        OPCODE(C5)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->BC.bytes.high;
+            r->SP--;
+            (*m)[r->SP] = r->BC.bytes.low;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // ADD A,n
+        OPCODE(C6)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->AF.bytes.high = add8(r->AF.bytes.high, d[0], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RST 00
+        OPCODE(C7)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->PC >> 8;
+            r->SP--;
+            (*m)[r->SP] = r->PC & 0xFF;
+            r->PC = 0 | 0x00;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // RET Z
+        OPCODE(C8)
+        {
+            r->PC += 1;
+            prevPC = r->PC;
+            retc(r, m, RetCondition::Z);
+            cycles += (r->PC != prevPC) ? 11 : 5;
+        }
+        END_OPCODE()
+
+        // RET
+        OPCODE(C9)
+        {
+            r->PC += 1;
+            r->PC = 0 | (*m)[r->SP];
+            r->SP++;
+            r->PC |= ((*m)[r->SP]) << 8;
+            r->SP++;
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // JP Z,nn
+        OPCODE(CA)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            if (r->AF.bytes.low.ZF)
+            {
+                r->PC = nn;
+            }
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // CALL Z,nn
+        OPCODE(CC)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            prevPC = r->PC;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            callc(r, m, RetCondition::Z, nn);
+            cycles += (r->PC != prevPC) ? 17 : 10;
+        }
+        END_OPCODE()
+
+        // CALL nn
+        OPCODE(CD)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            r->SP--;
+            (*m)[r->SP] = (r->PC) >> 8;
+            r->SP--;
+            (*m)[r->SP] = (r->PC) & 0xFF;
+            r->PC = nn;
+            cycles += 17;
+        }
+        END_OPCODE()
+
+        // ADC A,n
+        OPCODE(CE)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->AF.bytes.high = adc8(r->AF.bytes.high, d[0], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RST 08
+        OPCODE(CF)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->PC >> 8;
+            r->SP--;
+            (*m)[r->SP] = r->PC & 0xFF;
+            r->PC = 0 | 0x08;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // RET NC
+        OPCODE(D0)
+        {
+            r->PC += 1;
+            prevPC = r->PC;
+            retc(r, m, RetCondition::NC);
+            cycles += (r->PC != prevPC) ? 11 : 5;
+        }
+        END_OPCODE()
+
+        // POP DE
+        OPCODE(D1)
+        {
+            r->PC += 1;
+            uint8_t low = (*m)[r->SP++];
+            uint8_t high = (*m)[r->SP++];
+            r->DE.word = CREATE_WORD(low, high);
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // JP NC,nn
+        OPCODE(D2)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            if (!(r->AF.bytes.low.CF))
+            {
+                r->PC = nn;
+            }
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // OUT (n),A
+        OPCODE(D3)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            m_ioPorts.writeToPort(CREATE_WORD(d[0], r->AF.bytes.high), r->AF.bytes.high);
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // CALL NC,nn
+        OPCODE(D4)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            prevPC = r->PC;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            callc(r, m, RetCondition::NC, nn);
+            cycles += (r->PC != prevPC) ? 17 : 10;
+        }
+        END_OPCODE()
+
+        // PUSH DE
+        OPCODE(D5)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->DE.bytes.high;
+            r->SP--;
+            (*m)[r->SP] = r->DE.bytes.low;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // SUB n
+        OPCODE(D6)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->AF.bytes.high = sub8(r->AF.bytes.high, -(d[0]), r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RST 10
+        OPCODE(D7)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->PC >> 8;
+            r->SP--;
+            (*m)[r->SP] = r->PC & 0xFF;
+            r->PC = 0 | 0x10;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // RET C
+        OPCODE(D8)
+        {
+            r->PC += 1;
+            prevPC = r->PC;
+            retc(r, m, RetCondition::C);
+            cycles += (r->PC != prevPC) ? 11 : 5;
+        }
+        END_OPCODE()
+
+        // EXX
+        OPCODE(D9)
+        {
+            r->PC += 1;
+            uint16_t tmp = r->BC.word;
+            r->BC.word = r->BCx.word;
+            r->BCx.word = tmp;
+            tmp = r->DE.word;
+            r->DE.word = r->DEx.word;
+            r->DEx.word = tmp;
+            tmp = r->HL.word;
+            r->HL.word = r->HLx.word;
+            r->HLx.word = tmp;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // JP C,nn
+        OPCODE(DA)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            if (r->AF.bytes.low.CF)
+            {
+                r->PC = nn;
+            }
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // IN A,(n)
+        OPCODE(DB)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->AF.bytes.high = m_ioPorts.readPort(CREATE_WORD(d[0], r->AF.bytes.high));
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // CALL C,nn
+        OPCODE(DC)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            prevPC = r->PC;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            callc(r, m, RetCondition::C, nn);
+            cycles += (r->PC != prevPC) ? 17 : 10;
+        }
+        END_OPCODE()
+
+        // SBC A,n
+        OPCODE(DE)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->AF.bytes.high = sbc8(r->AF.bytes.high, -(d[0]), r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RST 18
+        OPCODE(DF)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->PC >> 8;
+            r->SP--;
+            (*m)[r->SP] = r->PC & 0xFF;
+            r->PC = 0 | 0x18;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // RET PO
+        OPCODE(E0)
+        {
+            r->PC += 1;
+            prevPC = r->PC;
+            retc(r, m, RetCondition::PO);
+            cycles += (r->PC != prevPC) ? 11 : 5;
+        }
+        END_OPCODE()
+
+        // POP HL
+        OPCODE(E1)
+        {
+            r->PC += 1;
+            uint8_t low = (*m)[r->SP++];
+            uint8_t high = (*m)[r->SP++];
+            r->HL.word = CREATE_WORD(low, high);
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // JP PO,nn
+        OPCODE(E2)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            if (!(r->AF.bytes.low.PF))
+            {
+                r->PC = nn;
+            }
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // EX (SP),HL
+        OPCODE(E3)
+        {
+            r->PC += 1;
+            uint8_t tmp = r->HL.bytes.low;
+            r->HL.bytes.low = (*m)[r->SP];
+            (*m)[r->SP] = tmp;
+            tmp = r->HL.bytes.high;
+            r->HL.bytes.high = (*m)[(r->SP)+1];
+            (*m)[(r->SP)+1] = tmp;
+            cycles += 19;
+        }
+        END_OPCODE()
+
+        // CALL PO,nn
+        OPCODE(E4)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            prevPC = r->PC;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            callc(r, m, RetCondition::PO, nn);
+            cycles += (r->PC != prevPC) ? 17 : 10;
+        }
+        END_OPCODE()
+
+        // PUSH HL
+        OPCODE(E5)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->HL.bytes.high;
+            r->SP--;
+            (*m)[r->SP] = r->HL.bytes.low;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // AND n
+        OPCODE(E6)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->AF.bytes.high = and8(r->AF.bytes.high, d[0], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RST 20
+        OPCODE(E7)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->PC >> 8;
+            r->SP--;
+            (*m)[r->SP] = r->PC & 0xFF;
+            r->PC = 0 | 0x20;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // RET PE
+        OPCODE(E8)
+        {
+            r->PC += 1;
+            prevPC = r->PC;
+            retc(r, m, RetCondition::PE);
+            cycles += (r->PC != prevPC) ? 11 : 5;
+        }
+        END_OPCODE()
+
+        // JP,(HL)
+        OPCODE(E9)
+        {
+            r->PC += 1;
+            r->PC = r->HL.word;     // wtf
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // JP PE,nn
+        OPCODE(EA)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            if (r->AF.bytes.low.PF)
+            {
+                r->PC = nn;
+            }
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // EX DE,HL
+        OPCODE(EB)
+        {
+            r->PC += 1;
+            uint16_t tmp = r->DE.word;
+            r->DE.word = r->HL.word;
+            r->HL.word = tmp;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CALL PE,nn
+        OPCODE(EC)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            prevPC = r->PC;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            callc(r, m, RetCondition::PE, nn);
+            cycles += (r->PC != prevPC) ? 17 : 10;
+        }
+        END_OPCODE()
+
+        // XOR n
+        OPCODE(EE)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->AF.bytes.high = xor8(r->AF.bytes.high, d[0], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RST 28
+        OPCODE(EF)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->PC >> 8;
+            r->SP--;
+            (*m)[r->SP] = r->PC & 0xFF;
+            r->PC = 0 | 0x28;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // RET P
+        OPCODE(F0)
+        {
+            r->PC += 1;
+            prevPC = r->PC;
+            retc(r, m, RetCondition::P);
+            cycles += (r->PC != prevPC) ? 11 : 5;
+        }
+        END_OPCODE()
+
+        // POP AF
+        OPCODE(F1)
+        {
+            r->PC += 1;
+            uint8_t low = (*m)[r->SP++];
+            uint8_t high = (*m)[r->SP++];
+            r->AF.word = CREATE_WORD(low, high);
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // JP P,nn
+        OPCODE(F2)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            if (!(r->AF.bytes.low.SF))
+            {
+                r->PC = nn;
+            }
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // DI
+        OPCODE(F3)
+        {
+            r->PC += 1;
+            m_IFF1 = false;
+            m_IFF2 = false;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CALL P,nn
+        OPCODE(F4)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            prevPC = r->PC;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            callc(r, m, RetCondition::P, nn);
+            cycles += (r->PC != prevPC) ? 17 : 10;
+        }
+        END_OPCODE()
+
+        // PUSH AF
+        OPCODE(F5)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->AF.bytes.high;
+            r->SP--;
+            (*m)[r->SP] = r->AF.bytes.low.byte;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // OR n
+        OPCODE(F6)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            r->AF.bytes.high = or8(r->AF.bytes.high, d[0], r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RST 30
+        OPCODE(F7)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->PC >> 8;
+            r->SP--;
+            (*m)[r->SP] = r->PC & 0xFF;
+            r->PC = 0 | 0x30;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+        // RET M
+        OPCODE(F8)
+        {
+            r->PC += 1;
+            prevPC = r->PC;
+            retc(r, m, RetCondition::M);
+            cycles += (r->PC != prevPC) ? 11 : 5;
+        }
+        END_OPCODE()
+
+        // LD SP,HL
+        OPCODE(F9)
+        {
+            r->PC += 1;
+            r->SP = r->HL.word;
+            cycles += 6;
+        }
+        END_OPCODE()
+
+        // JP M,nn
+        OPCODE(FA)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            if (r->AF.bytes.low.SF)
+            {
+                r->PC = nn;
+            }
+            cycles += 10;
+        }
+        END_OPCODE()
+
+        // EI
+        OPCODE(FB)
+        {
+            r->PC += 1;
+            m_IFF1 = true;
+            m_IFF2 = true;
+            cycles += 4;
+        }
+        END_OPCODE()
+
+        // CALL M,nn
+        OPCODE(FC)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            d.bytes[1] = (*m)[(uint16_t)(r->PC + 1)];
+            r->PC += 2;
+            prevPC = r->PC;
+            uint16_t nn = CREATE_WORD(d[0], d[1]);
+            callc(r, m, RetCondition::M, nn);
+            cycles += (r->PC != prevPC) ? 17 : 10;
+        }
+        END_OPCODE()
+
+        // CP n
+        OPCODE(FE)
+        {
+            r->PC += 1;
+            d.bytes[0] = (*m)[r->PC];
+            r->PC += 1;
+            sub8(r->AF.bytes.high, -(d[0]), r);
+            cycles += 7;
+        }
+        END_OPCODE()
+
+        // RST 38
+        OPCODE(FF)
+        {
+            r->PC += 1;
+            r->SP--;
+            (*m)[r->SP] = r->PC >> 8;
+            r->SP--;
+            (*m)[r->SP] = r->PC & 0xFF;
+            r->PC = 0 | 0x38;
+            cycles += 11;
+        }
+        END_OPCODE()
+
+
+        // Prefixed opcodes
+        OPCODE(CB)
+        OPCODE(DD)
+        OPCODE(FD)
+        {
+            m_registers = registers;
+            cycles += executeInstruction();
+            registers = m_registers;
+        }
+        END_OPCODE()
+
+        OPCODE(ED)
+        {
+            m_registers = registers;
+            if (isRepeatedOpcodeED((*m)[(uint16_t)(r->PC + 1)]))
+            {
+                cycles += runRepeated(cycles, cycleLimit);
+            }
+            else
+            {
+                cycles += executeInstruction();
+            }
+            registers = m_registers;
+        }
+        END_OPCODE()
+
+#ifdef Z80_COMPUTED_GOTO
+    }
+done:
+#else
+        }
+        if (cycles > cycleLimit) { break; }
+    }
+#endif
+
+    m_registers = registers;
+    m_cyclesSinceLastFrame = cycles;
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include "block_cache.h"
+#include "instructions.h"
+#include "utils.h"
+
+// Opcodes that jump, call, return or repeat. Decoding stops after them since
+// the following bytes usually aren't executed next.
+static const uint8_t branchOpcodes[] = {
+    0x10, 0x18, 0x20, 0x28, 0x30, 0x38,                     // DJNZ, JR
+    0x76,                                                   // HALT
+    0xC0, 0xC8, 0xD0, 0xD8, 0xE0, 0xE8, 0xF0, 0xF8, 0xC9,   // RET
+    0xC2, 0xCA, 0xD2, 0xDA, 0xE2, 0xEA, 0xF2, 0xFA, 0xC3,   // JP
+    0xC4, 0xCC, 0xD4, 0xDC, 0xE4, 0xEC, 0xF4, 0xFC, 0xCD,   // CALL
+    0xC7, 0xCF, 0xD7, 0xDF, 0xE7, 0xEF, 0xF7, 0xFF,         // RST
+    0xE9                                                    // JP (HL), JP (IX), JP (IY)
+};
+
+static const uint8_t branchOpcodesED[] = {
+    0x45, 0x4D, 0x55, 0x5D, 0x65, 0x6D, 0x75, 0x7D          // RETN, RETI
+};
+
+// Repeated block instructions, also end a block
+static const uint8_t repeatOpcodesED[] = {
+    0xB0, 0xB1, 0xB2, 0xB3, 0xB8, 0xB9, 0xBA, 0xBB
+};
+
+// Change IFF1/IFF2 or the interrupt mode
+static const uint8_t interruptOpcodes[] = {
+    0xF3, 0xFB                                              // DI, EI
+};
+
+static const uint8_t interruptOpcodesED[] = {
+    0x46, 0x4E, 0x56, 0x5E, 0x66, 0x6E, 0x76, 0x7E          // IM 0, IM 1, IM 2 and undocumented copies
+};
+
+static const uint8_t portOpcodes[] = {
+    0xD3, 0xDB                                              // OUT (n),A, IN A,(n)
+};
+
+static const uint8_t portOpcodesED[] = {
+    0x40, 0x48, 0x50, 0x58, 0x60, 0x68, 0x70, 0x78,         // IN r,(C)
+    0x41, 0x49, 0x51, 0x59, 0x61, 0x69, 0x71, 0x79,         // OUT (C),r
+    0xA2, 0xA3, 0xAA, 0xAB, 0xB2, 0xB3, 0xBA, 0xBB          // INI, OUTI, IND, OUTD and repeats
+};
+
+// LD A,(HL); INC HL
+static void loadIncrementHL(Z80* z, Spectrum48KMemory* m, InstructionData d)
+{
+    Z80Registers* r = z->getRegisters();
+    r->AF.bytes.high = (*m)[r->HL.word];
+    r->HL.word++;
+}
+
+// LD A,(DE); INC DE
+static void loadIncrementDE(Z80* z, Spectrum48KMemory* m, InstructionData d)
+{
+    Z80Registers* r = z->getRegisters();
+    r->AF.bytes.high = (*m)[r->DE.word];
+    r->DE.word++;
+}
+
+// LD (HL),A; INC HL
+static void storeIncrementHL(Z80* z, Spectrum48KMemory* m, InstructionData d)
+{
+    Z80Registers* r = z->getRegisters();
+    (*m)[r->HL.word] = r->AF.bytes.high;
+    // Overwrote the INC HL, it has to be decoded again
+    if (r->HL.word == (uint16_t) (r->PC - 1)) { r->PC--; return; }
+    r->HL.word++;
+}
+
+// LD (DE),A; INC DE
+static void storeIncrementDE(Z80* z, Spectrum48KMemory* m, InstructionData d)
+{
+    Z80Registers* r = z->getRegisters();
+    (*m)[r->DE.word] = r->AF.bytes.high;
+    if (r->DE.word == (uint16_t) (r->PC - 1)) { r->PC--; return; }
+    r->DE.word++;
+}
+
+// DEC BC; LD A,B; OR C; JR NZ,d
+static void countdownLoopBC(Z80* z, Spectrum48KMemory* m, InstructionData d)
+{
+    Z80Registers* r = z->getRegisters();
+    r->BC.word--;
+    r->AF.bytes.high = or8(r->BC.bytes.high, r->BC.bytes.low, r);
+    if (!r->AF.bytes.low.ZF) { r->PC += (int8_t) d[0]; }
+}
+
+// Hand picked, each needs its own handler above: the BC countdown that ends
+// most delay and block loops, and the pointer walks of copy and fill loops
+// that don't use LDIR. Longest first. runSuperinstructionBenchmark prints how
+// often each one runs in its workloads next to the most frequent n-grams. On
+// the built in program the countdown covers 22% of the instructions and
+// LD (HL),A; INC HL 11%, together a 22% cut in dispatches. The other three
+// don't occur there and need the ROM or game code to show up.
+static const Superinstruction superinstructionPatterns[] = {
+    { { 0x0B, 0x78, 0xB1, 0x20 }, 4, countdownLoopBC, 0, 0, 0, 0 },
+    { { 0x7E, 0x23, 0, 0 }, 2, loadIncrementHL, 0, 0, 0, 0 },
+    { { 0x1A, 0x13, 0, 0 }, 2, loadIncrementDE, 0, 0, 0, 0 },
+    { { 0x77, 0x23, 0, 0 }, 2, storeIncrementHL, 0, 0, 0, 0 },
+    { { 0x12, 0x13, 0, 0 }, 2, storeIncrementDE, 0, 0, 0, 0 }
+};
+
+BlockCache::BlockCache()
+    : m_blocks(NUM_BLOCKS),
+      m_instructions(nullptr),
+      m_decoder(nullptr)
+{
+    m_endsBlock.fill(false);
+    m_usesPorts.fill(false);
+    m_repeats.fill(false);
+    for (uint8_t opcode : branchOpcodes)
+    {
+        m_endsBlock[opcode] = true;             // Unprefixed
+        m_endsBlock[256 + opcode] = true;       // DD
+        m_endsBlock[512 + opcode] = true;       // FD
+    }
+    for (uint8_t opcode : branchOpcodesED)
+    {
+        m_endsBlock[768 + opcode] = true;
+    }
+    for (uint8_t opcode : repeatOpcodesED)
+    {
+        m_endsBlock[768 + opcode] = true;
+        m_repeats[768 + opcode] = true;
+    }
+    for (uint8_t opcode : portOpcodes)
+    {
+        m_usesPorts[opcode] = true;
+        m_usesPorts[256 + opcode] = true;
+        m_usesPorts[512 + opcode] = true;
+    }
+    for (uint8_t opcode : portOpcodesED)
+    {
+        m_usesPorts[768 + opcode] = true;
+    }
+    const InstructionTable& table = z80InstructionTable();
+    for (int i = 0; i < NUM_INSTRUCTIONS; i++)
+    {
+        const MicroProgram& program = table.micro[i];
+        m_sideEffects[i] = false;
+        for (int op = 0; op < program.count; op++)
+        {
+            m_sideEffects[i] |= program.ops[op].type == MicroOpType::WRITE || program.ops[op].type == MicroOpType::PORT_WRITE;
+        }
+    }
+    for (uint8_t opcode : interruptOpcodes)
+    {
+        m_sideEffects[opcode] = true;
+        m_sideEffects[256 + opcode] = true;
+        m_sideEffects[512 + opcode] = true;
+    }
+    for (uint8_t opcode : interruptOpcodesED)
+    {
+        m_sideEffects[768 + opcode] = true;
+    }
+    clear();
+    resetStats();
+}
+
+void BlockCache::loadInstructionSet(const InstructionHot* instructions, const Z80Decoder* decoder)
+{
+    m_instructions = instructions;
+    m_decoder = decoder;
+
+    m_superinstructions.clear();
+    for (Superinstruction s : superinstructionPatterns)
+    {
+        s.length = s.count;
+        s.leadCycles = 0;
+        for (int i = 0; i + 1 < s.count; i++)
+        {
+            s.leadCycles += instructions[s.opcodes[i]].cycles;
+        }
+        const InstructionHot& last = instructions[s.opcodes[s.count - 1]];
+        s.length += last.numDataBytes;
+        s.cycles = s.leadCycles + last.cycles;
+        s.cyclesOnJump = last.cyclesOnJump != last.cycles ? s.leadCycles + last.cyclesOnJump : s.leadCycles;
+        m_superinstructions.push_back(s);
+    }
+    clear();
+}
+
+void BlockCache::setSuperinstructionsEnabled(bool enabled)
+{
+    m_superinstructionsEnabled = enabled;
+    clear();
+}
+
+void BlockCache::clear()
+{
+    for (BasicBlock& block : m_blocks)
+    {
+        block.pc = 0;
+        block.count = 0;
+        block.usesPorts = false;
+        block.repeats = false;
+        block.idleLoop = false;
+        block.pageWrites = 0;
+    }
+}
+
+const BlockCache::Stats& BlockCache::getStats() const
+{
+    return m_stats;
+}
+
+void BlockCache::resetStats()
+{
+    m_stats = {};
+}
+
+void BlockCache::build(BasicBlock& block, Spectrum48KMemory& m, uint16_t pc)
+{
+    block.pc = pc;
+    block.count = 0;
+    block.usesPorts = false;
+    block.repeats = false;
+    block.idleLoop = false;
+    block.pageWrites = m.pageWrites[pc >> Spectrum48KMemory::PAGE_SHIFT];
+
+    const int pageEnd = (pc | 0xFF) + 1;
+    int address = pc;
+    uint16_t indices[BasicBlock::MAX_INSTRUCTIONS];
+    bool sideEffects = false;
+    while (block.count < BasicBlock::MAX_INSTRUCTIONS)
+    {
+        DecodedOpcode op = m_decoder->decode(m, (uint16_t) address);
+        const InstructionHot& instruction = m_instructions[op.index];
+        int length = op.length + op.numDataBytes;
+        if (!instruction.execute || address + length > pageEnd) { break; }
+
+        // Same operand layout as Z80::getInstructionData
+        PredecodedInstruction& p = block.instructions[block.count++];
+        p.execute = instruction.execute;
+        p.data = {};
+        for (int i = 0; i < op.numDataBytes - op.dataOffset; i++)
+        {
+            p.data.bytes[i] = m[(uint16_t) (address + op.length + op.dataOffset + i)];
+        }
+        p.length = (uint8_t) length;
+        p.superinstruction = 0;
+        p.cycles = instruction.cycles + 4 * op.ignoredPrefixes;
+        p.cyclesOnJump = instruction.cyclesOnJump + 4 * op.ignoredPrefixes;
+
+        indices[block.count - 1] = op.ignoredPrefixes ? 0xFFFF : op.index;
+        sideEffects |= m_sideEffects[op.index];
+        block.usesPorts |= m_usesPorts[op.index];
+        block.repeats = m_repeats[op.index] && block.count == 1 && op.ignoredPrefixes == 0;
+        address += length;
+        if (m_endsBlock[op.index])
+        {
+            // JR, JR cc, JP nn and JP cc back to the start of the block, the DD
+            // and FD pages repeat them with an ignored prefix
+            uint8_t opcode = op.index & 0xFF;
+            uint16_t target = address;
+            if (op.index < 768 && (opcode == 0x18 || (opcode & 0xE7) == 0x20)) { target = address + (int8_t) p.data[0]; }
+            else if (op.index < 768 && (opcode == 0xC3 || (opcode & 0xC7) == 0xC2)) { target = CREATE_WORD(p.data[0], p.data[1]); }
+            block.idleLoop = target == pc && !sideEffects;
+            break;
+        }
+    }
+
+    if (!m_superinstructionsEnabled) { return; }
+    for (int i = 0; i < block.count; i++)
+    {
+        for (int s = 0; s < (int) m_superinstructions.size() && !block.instructions[i].superinstruction; s++)
+        {
+            const Superinstruction& super = m_superinstructions[s];
+            int n = 0;
+            while (n < super.count && i + n < block.count && indices[i + n] == super.opcodes[n]) { n++; }
+            if (n == super.count) { block.instructions[i].superinstruction = s + 1; }
+        }
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <stdint.h>
+#include <array>
+#include <vector>
+
+#include "defines.h"
+#include "instruction.h"
+#include "decoder.h"
+#include "Memory.h"
+
+// Instruction with its operands already read, ready to execute
+struct PredecodedInstruction {
+    InstructionHandler execute;
+    InstructionData data;
+    uint8_t length;             // Opcode and operand bytes
+    uint8_t superinstruction;   // 1 + index of the superinstruction starting here, 0 if none
+    uint16_t cycles;            // Including ignored DD/FD prefixes
+    uint16_t cyclesOnJump;
+};
+
+// Recurring run of instructions executed with one dispatch. It changes PC
+// either by its final jump or by stopping in front of an instruction it
+// overwrote, in which case only the instructions before it have run.
+struct Superinstruction {
+    static const int MAX_INSTRUCTIONS = 4;
+
+    uint16_t opcodes[MAX_INSTRUCTIONS];     // Instruction set indices, only the last may have operands
+    uint8_t count;
+    InstructionHandler execute;             // Gets the operands of the last instruction
+
+    // Filled in from the instruction set
+    uint8_t length;
+    uint16_t leadCycles;                    // All but the last instruction
+    uint16_t cycles;
+    uint16_t cyclesOnJump;
+};
+
+// Straight line run of instructions starting at pc. A block never crosses a
+// 256 byte memory page, so a single page write counter tells whether any of
+// its bytes were modified since it was decoded.
+struct BasicBlock {
+    static const int MAX_INSTRUCTIONS = 16;
+
+    uint16_t pc;
+    uint8_t count;              // 0 when the slot is empty
+    bool usesPorts;             // Contains an IN or OUT instruction
+    bool repeats;               // A lone LDIR, CPIR, ... that Z80::runRepeated executes in bulk
+    bool idleLoop;              // Jumps back to pc, only changes registers, see Z80::skipIdleLoop
+    uint32_t pageWrites;        // Spectrum48KMemory::pageWrites of the page when decoded
+    PredecodedInstruction instructions[MAX_INSTRUCTIONS];
+};
+
+// Direct mapped cache of basic blocks keyed by their start address
+class BlockCache {
+    public:
+        static const int NUM_BLOCKS = 1024;
+
+        struct Stats {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t instructions;      // Executed from a cached block
+            uint64_t superinstructions; // Dispatches that ran several of them
+            uint64_t fused;             // Instructions run by those dispatches
+        };
+
+        BlockCache();
+
+        void loadInstructionSet(const InstructionHot* instructions, const Z80Decoder* decoder);
+
+        // Drop every block, needed after memory[] was written directly
+        void clear();
+
+        // Fuse the runs of Superinstruction::opcodes found in a block (on by default)
+        void setSuperinstructionsEnabled(bool enabled);
+
+        inline const Superinstruction& superinstruction(uint8_t id) const { return m_superinstructions[id - 1]; }
+        inline int getSuperinstructionCount() const { return (int) m_superinstructions.size(); }
+
+        // Block starting at pc, decoded again if missing or if its page was written.
+        // Returns nullptr when the instruction at pc can't be cached.
+        inline const BasicBlock* lookup(Spectrum48KMemory& m, uint16_t pc)
+        {
+            BasicBlock& block = m_blocks[pc & (NUM_BLOCKS - 1)];
+            if (block.pc == pc && block.count != 0 &&
+                block.pageWrites == m.pageWrites[pc >> Spectrum48KMemory::PAGE_SHIFT])
+            {
+                m_stats.hits++;
+                return &block;
+            }
+            m_stats.misses++;
+            build(block, m, pc);
+            return block.count ? &block : nullptr;
+        }
+
+        inline void countInstructions(int n) { m_stats.instructions += n; }
+        inline void countSuperinstruction(int n) { m_stats.superinstructions++; m_stats.fused += n; }
+        inline void countSuperinstructions(int runs, int n) { m_stats.superinstructions += runs; m_stats.fused += n; }
+
+        const Stats& getStats() const;
+        void resetStats();
+
+    private:
+        void build(BasicBlock& block, Spectrum48KMemory& m, uint16_t pc);
+
+        std::vector<BasicBlock> m_blocks;
+        const InstructionHot* m_instructions;
+        const Z80Decoder* m_decoder;
+        std::array<bool, NUM_INSTRUCTIONS> m_endsBlock;     // Instruction may change PC
+        std::array<bool, NUM_INSTRUCTIONS> m_usesPorts;     // Instruction reads or writes a port
+        std::array<bool, NUM_INSTRUCTIONS> m_repeats;       // LDIR, CPIR, INIR, OTIR and decrementing versions
+        std::array<bool, NUM_INSTRUCTIONS> m_sideEffects;   // Writes memory or ports, or changes the interrupt state
+        std::vector<Superinstruction> m_superinstructions;
+        bool m_superinstructionsEnabled = true;
+        Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "contention.h"
+#include "spectrum128k.h"
+#include "Z80.h"
+
+const ULAContention::Timing ULAContention::TIMING_48K = { 69888, 14335, 224 };
+const ULAContention::Timing ULAContention::TIMING_128K = { 70908, 14361, 228 };
+
+ULAContention::ULAContention(Spectrum48KMemory* memory, const Z80Registers* registers)
+    : m_timing(TIMING_48K), m_memory(memory), m_registers(registers), m_numContendedBanks(0)
+{
+    m_contendedBanks[m_numContendedBanks++] = memory->banks[1];
+    buildTable();
+}
+
+ULAContention::ULAContention(Spectrum128KMemory* memory, const Z80Registers* registers)
+    : m_timing(TIMING_128K), m_memory(memory), m_registers(registers), m_numContendedBanks(0)
+{
+    for (int bank = 1; bank < Spectrum128KMemory::NUM_RAM_BANKS; bank += 2)
+    {
+        m_contendedBanks[m_numContendedBanks++] = memory->ram[bank];
+    }
+    buildTable();
+}
+
+void ULAContention::buildTable()
+{
+    // The ULA reads two bytes of pixels and two of attributes every 8 T-states,
+    // an access waits until the next free slot
+    static const uint8_t pattern[8] = { 6, 5, 4, 3, 2, 1, 0, 0 };
+
+    m_delays.assign(m_timing.frameCycles, 0);
+    for (int line = 0; line < SCREEN_LINES; line++)
+    {
+        int start = m_timing.firstContended + line * m_timing.lineCycles;
+        for (int n = 0; n < CONTENDED_CYCLES; n++) { m_delays[start + n] = pattern[n % 8]; }
+    }
+}
+
+bool ULAContention::isContended(uint16_t address) const
+{
+    const uint8_t* bank = m_memory->readSlots[address >> Spectrum48KMemory::SLOT_SHIFT];
+    for (int i = 0; i < m_numContendedBanks; i++)
+    {
+        if (bank == m_contendedBanks[i]) { return true; }
+    }
+    return false;
+}
+
+// An access of cycles T-states (none for internal ones) stretched to length,
+// each extra T-state is contended on its own at address
+int ULAContention::memoryCycle(uint16_t address, int tstate, int cycles, int length) const
+{
+    if (!isContended(address)) { return 0; }
+
+    int waits = 0;
+    for (int i = 0; i < length; )
+    {
+        int span = (i == 0 && cycles > 0) ? cycles : 1;
+        int wait = delay(tstate);
+        waits += wait;
+        tstate += wait + span;
+        i += span;
+    }
+    return waits;
+}
+
+// The ULA owns even ports, a high byte in contended memory contends the bus as
+// a memory access would:
+//   high byte contended, even:     C:1, C:3
+//   high byte contended, odd:      C:1, C:1, C:1, C:1
+//   high byte uncontended, even:   N:1, C:3
+//   high byte uncontended, odd:    N:4
+int ULAContention::portCycle(uint16_t port, int tstate) const
+{
+    const bool ula = (port & 0x0001) == 0;
+    if (!isContended(port))
+    {
+        return ula ? delay(tstate + 1) : 0;
+    }
+
+    int waits = 0;
+    for (int i = 0; i < (ula ? 2 : 4); i++)
+    {
+        int wait = delay(tstate);
+        waits += wait;
+        tstate += wait + (ula && i == 1 ? 3 : 1);
+    }
+    return waits;
+}
+
+int ULAContention::busCycle(MicroOpType type, uint16_t address, int tstate, int length)
+{
+    switch (type)
+    {
+        case MicroOpType::FETCH:
+        {
+            // Refresh follows the opcode read, the extra T-states of a long fetch
+            // keep IR on the bus
+            int waits = memoryCycle(address, tstate, 4, 4);
+            return waits + memoryCycle(m_registers->IR.word, tstate + waits + 4, 0, length - 4);
+        }
+        case MicroOpType::READ:
+        case MicroOpType::WRITE:
+            return memoryCycle(address, tstate, 3, length);
+        case MicroOpType::INTERNAL:
+            return memoryCycle(address, tstate, 0, length);
+        case MicroOpType::PORT_READ:
+        case MicroOpType::PORT_WRITE:
+            return portCycle(address, tstate);
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef CONTENTION_H
+#define CONTENTION_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "micro_ops.h"
+
+struct Spectrum48KMemory;
+struct Spectrum128KMemory;
+struct Z80Registers;
+
+// ULA memory contention: while the ULA fetches the screen, the CPU waits on
+// accesses to the contended banks and on ports the ULA decodes. The delay of
+// every T-state of the frame is precomputed, so a bus cycle costs a lookup.
+// Runs as the bus listener of the Z80, without one (or built with
+// Z80_NO_BUS_LISTENER) the fast cores run and contention costs nothing.
+class ULAContention : public IBusListener {
+    public:
+        struct Timing {
+            int frameCycles;
+            int firstContended;     // T-state of the first delay on the top screen line
+            int lineCycles;
+        };
+        static const Timing TIMING_48K;
+        static const Timing TIMING_128K;
+
+        static const int SCREEN_LINES = 192;
+        static const int CONTENDED_CYCLES = 128;    // Per line, the rest is border and retrace
+
+        // 4000h-7FFFh is contended on the 48K
+        ULAContention(Spectrum48KMemory* memory, const Z80Registers* registers);
+        // Odd RAM banks are contended on the 128K, wherever they are paged in
+        ULAContention(Spectrum128KMemory* memory, const Z80Registers* registers);
+
+        const Timing& getTiming() const { return m_timing; }
+
+        // Wait states of a contended access at tstate (frame relative), 0 outside
+        // the screen fetch and past the end of the frame
+        inline int delay(int tstate) const
+        {
+            return (unsigned) tstate < m_delays.size() ? m_delays[tstate] : 0;
+        }
+        bool isContended(uint16_t address) const;
+
+        int busCycle(MicroOpType type, uint16_t address, int tstate, int length) override;
+
+    private:
+        void buildTable();
+        int memoryCycle(uint16_t address, int tstate, int cycles, int length) const;
+        int portCycle(uint16_t port, int tstate) const;
+
+        Timing m_timing;
+        const Spectrum48KMemory* m_memory;
+        const Z80Registers* m_registers;    // IR is on the bus in the extra T-states of a fetch
+        const uint8_t* m_contendedBanks[4];
+        int m_numContendedBanks;
+        std::vector<uint8_t> m_delays;
+};
+
+#endif
@@ -35,7 +35,8 @@ Breakpoint::Breakpoint(uint16_t address, BreakpointCondition cond,
     : m_address(address),
       m_condition(cond),
       m_operator(op),
-      m_conditionNumber(num)
+      m_conditionNumber(num),
+      m_enabled(false)
 {
     m_is16bit = (cond > BreakpointCondition::NONE && cond <= BreakpointCondition::SP);
 }
@@ -0,0 +1,65 @@
+#include "decoder.h"
+
+// Page offsets in the instruction set
+#define PAGE_DD     256
+#define PAGE_FD     512
+#define PAGE_ED     768
+#define PAGE_CB     1024
+#define PAGE_DDCB   2304
+#define PAGE_FDCB   2560
+
+typedef std::array<std::array<uint16_t, 256>, Z80Decoder::NUM_STATES> DecodeTable;
+
+// Entry for a prefix byte seen in any state except ED and CB
+static constexpr uint16_t prefixEntry(uint8_t byte)
+{
+    switch (byte)
+    {
+        case 0xDD: return Z80Decoder::PREFIX | Z80Decoder::DD;
+        case 0xFD: return Z80Decoder::PREFIX | Z80Decoder::FD;
+        case 0xED: return Z80Decoder::PREFIX | Z80Decoder::ED;
+        default:   return 0;
+    }
+}
+
+static constexpr DecodeTable buildDecodeTable()
+{
+    DecodeTable t = {};
+    for (int b = 0; b < 256; b++)
+    {
+        uint8_t byte = (uint8_t) b;
+        uint16_t prefix = prefixEntry(byte);
+
+        t[Z80Decoder::BASE][b] = prefix ? prefix
+            : (byte == 0xCB) ? (uint16_t) (Z80Decoder::PREFIX | Z80Decoder::CB) : byte;
+
+        // DD DD, DD FD and DD ED discard the first prefix
+        t[Z80Decoder::DD][b] = prefix ? prefix
+            : (byte == 0xCB) ? (uint16_t) (Z80Decoder::DISPLACED | PAGE_DDCB) : (uint16_t) (PAGE_DD + byte);
+        t[Z80Decoder::FD][b] = prefix ? prefix
+            : (byte == 0xCB) ? (uint16_t) (Z80Decoder::DISPLACED | PAGE_FDCB) : (uint16_t) (PAGE_FD + byte);
+
+        // Any byte after ED or CB is the opcode
+        t[Z80Decoder::ED][b] = PAGE_ED + byte;
+        t[Z80Decoder::CB][b] = PAGE_CB + byte;
+    }
+    return t;
+}
+
+const DecodeTable Z80Decoder::s_table = buildDecodeTable();
+
+Z80Decoder::Z80Decoder()
+{
+    for (int i = 0; i < NUM_INSTRUCTIONS; i++)
+    {
+        m_numDataBytes[i] = 0;
+    }
+}
+
+void Z80Decoder::loadInstructionSet(const std::array<InstructionHot, NUM_INSTRUCTIONS>& instructionSet)
+{
+    for (int i = 0; i < NUM_INSTRUCTIONS; i++)
+    {
+        m_numDataBytes[i] = (uint8_t) instructionSet[i].numDataBytes;
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stdint.h>
+#include <array>
+
+#include "defines.h"
+#include "instruction.h"
+#include "Memory.h"
+
+// Result of decoding the opcode bytes at a memory location
+struct DecodedOpcode {
+    uint16_t index;             // Index into z80InstructionSet()
+    uint8_t length;             // Opcode bytes including prefixes (and DDCB/FDCB displacement)
+    uint8_t numDataBytes;       // Operand bytes following the opcode
+    int8_t dataOffset;          // First operand relative to the end of the opcode (-1 for DDCB/FDCB)
+    uint8_t ignoredPrefixes;    // Redundant DD/FD prefixes, each executes as a 4 T-state NOP
+};
+
+// Table driven opcode decoder, replaces walking the prefixes byte by byte.
+// Each decode state (no prefix, DD, FD, ED, CB) has a 256 entry table. An entry
+// is either the final index into the instruction set or a transition to the
+// next state, so decoding takes one table load per opcode byte.
+class Z80Decoder {
+    public:
+        enum State : uint8_t { BASE = 0, DD, FD, ED, CB, NUM_STATES };
+
+        // Entry flags
+        static const uint16_t PREFIX = 0x8000;      // Low bits are the next state
+        static const uint16_t DISPLACED = 0x4000;   // Low bits are the page base, opcode follows displacement
+        static const uint16_t VALUE_MASK = 0x0FFF;
+
+        static const uint8_t MAX_IGNORED_PREFIXES = 64;
+
+        Z80Decoder();
+
+        // Copy the operand lengths out of the instruction table
+        void loadInstructionSet(const std::array<InstructionHot, NUM_INSTRUCTIONS>& instructionSet);
+
+        inline DecodedOpcode decode(Spectrum48KMemory& m, uint16_t pc) const
+        {
+            DecodedOpcode op;
+            uint8_t length = 1;
+            uint8_t ignored = 0;
+            uint16_t entry = s_table[BASE][m[pc]];
+            while (entry & PREFIX)
+            {
+                State state = (State) (entry & VALUE_MASK);
+                uint16_t next = s_table[state][m[(uint16_t)(pc + length)]];
+                // A DD/FD followed by another prefix has no effect
+                if ((next & PREFIX) && (state == DD || state == FD))
+                {
+                    if (ignored == MAX_IGNORED_PREFIXES)
+                    {
+                        // Long prefix runs are split up and executed as a NOP
+                        op.index = 0;
+                        op.length = length;
+                        op.numDataBytes = 0;
+                        op.dataOffset = 0;
+                        op.ignoredPrefixes = length - 1;
+                        return op;
+                    }
+                    ignored++;
+                }
+                entry = next;
+                length++;
+            }
+            op.dataOffset = 0;
+            if (entry & DISPLACED)
+            {
+                // DD CB d op / FD CB d op: the displacement is read as the first operand
+                entry = (entry & VALUE_MASK) + m[(uint16_t)(pc + length + 1)];
+                length++;
+                op.dataOffset = -1;
+            }
+            op.index = entry;
+            op.length = length;
+            op.numDataBytes = m_numDataBytes[entry];
+            op.ignoredPrefixes = ignored;
+            return op;
+        }
+
+    private:
+        static const std::array<std::array<uint16_t, 256>, NUM_STATES> s_table;
+        uint8_t m_numDataBytes[NUM_INSTRUCTIONS];
+};
+
+#endif
@@ -9,5 +9,7 @@ class IDevice {
     
     virtual void receiveData(uint8_t data, uint16_t port) = 0;
 
+    // Must give the same answer until the next scheduled event, loops polling
+    // a port are skipped to it (see Z80::skipIdleLoop)
     virtual bool sendData(uint8_t& out, uint16_t port) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,327 @@
+#include "dynarec.h"
+#include "Z80.h"
+
+#include <cstring>
+#include <initializer_list>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+// Upper bound on the code emitted for one block, a superinstruction and its
+// exit stubs included
+static const size_t MAX_BLOCK_CODE = 256 * BasicBlock::MAX_INSTRUCTIONS + 128;
+// Granularity of the protection changes, x86-64 hosts use 4K pages
+static const size_t PROTECT_SIZE = 4096;
+
+// The buffer is never writable and executable at once: it's mapped read/write,
+// protect() makes it executable once a block is written
+static uint8_t* allocateExecutable(size_t size)
+{
+#if !defined(Z80_DYNAREC_SUPPORTED)
+    return nullptr;
+#elif defined(_WIN32)
+    return (uint8_t*) VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? nullptr : (uint8_t*) p;
+#endif
+}
+
+static void freeExecutable(uint8_t* p, size_t size)
+{
+    if (!p) { return; }
+#ifdef _WIN32
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, size);
+#endif
+}
+
+#ifdef Z80_DYNAREC_SUPPORTED
+
+static_assert(offsetof(DynarecFrame, z) == 0, "DynarecFrame layout is used by generated code");
+static_assert(offsetof(DynarecFrame, m) == 8, "DynarecFrame layout is used by generated code");
+static_assert(offsetof(DynarecFrame, registers) == 16, "DynarecFrame layout is used by generated code");
+static_assert(offsetof(DynarecFrame, pageWrites) == 24, "DynarecFrame layout is used by generated code");
+static_assert(offsetof(DynarecFrame, cycleBudget) == 32, "DynarecFrame layout is used by generated code");
+static_assert(offsetof(DynarecFrame, instructions) == 36, "DynarecFrame layout is used by generated code");
+static_assert(offsetof(DynarecFrame, superinstructions) == 40, "DynarecFrame layout is used by generated code");
+static_assert(offsetof(DynarecFrame, fused) == 44, "DynarecFrame layout is used by generated code");
+static_assert(sizeof(InstructionData) == 2, "Operands are passed to handlers in a register");
+
+// Writable and not executable, or executable and not writable, for the pages
+// holding size bytes at p
+static bool protect(uint8_t* p, size_t size, bool executable)
+{
+    uintptr_t first = (uintptr_t) p & ~(uintptr_t) (PROTECT_SIZE - 1);
+    uintptr_t last = ((uintptr_t) p + size + PROTECT_SIZE - 1) & ~(uintptr_t) (PROTECT_SIZE - 1);
+#ifdef _WIN32
+    DWORD old;
+    if (!VirtualProtect((void*) first, last - first, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old)) { return false; }
+    if (executable) { FlushInstructionCache(GetCurrentProcess(), (void*) first, last - first); }
+    return true;
+#else
+    return mprotect((void*) first, last - first, executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+// Appends x86-64 machine code to a buffer
+class CodeWriter {
+    public:
+        CodeWriter(uint8_t* start) : m_p(start) {}
+
+        uint8_t* position() const { return m_p; }
+
+        void bytes(std::initializer_list<uint8_t> b) { for (uint8_t x : b) { *m_p++ = x; } }
+        void imm16(uint16_t v) { std::memcpy(m_p, &v, 2); m_p += 2; }
+        void imm32(uint32_t v) { std::memcpy(m_p, &v, 4); m_p += 4; }
+        void imm64(uint64_t v) { std::memcpy(m_p, &v, 8); m_p += 8; }
+
+        // Emit a rel32 placeholder, returns where to patch it
+        uint8_t* rel32() { uint8_t* at = m_p; imm32(0); return at; }
+        static void patch(uint8_t* at, const uint8_t* target)
+        {
+            int32_t rel = (int32_t) (target - (at + 4));
+            std::memcpy(at, &rel, 4);
+        }
+
+        // Set PC, then call handler(z, m, data) with the registers below
+        void callHandler(InstructionHandler handler, InstructionData data, uint16_t pc, uint8_t pcOffset)
+        {
+            bytes({ 0x66, 0x41, 0xC7, 0x45, pcOffset });    // mov word [r13+PC], pc
+            imm16(pc);
+#ifdef _WIN32
+            bytes({ 0x48, 0x89, 0xD9 });                    // mov rcx, rbx
+            bytes({ 0x4C, 0x89, 0xE2 });                    // mov rdx, r12
+            bytes({ 0x41, 0xB8 });                          // mov r8d, data
+#else
+            bytes({ 0x48, 0x89, 0xDF });                    // mov rdi, rbx
+            bytes({ 0x4C, 0x89, 0xE6 });                    // mov rsi, r12
+            bytes({ 0xBA });                                // mov edx, data
+#endif
+            imm32(data.bytes[0] | (data.bytes[1] << 8));
+            bytes({ 0x48, 0xB8 });                          // mov rax, handler
+            imm64((uint64_t) (uintptr_t) handler);
+            bytes({ 0xFF, 0xD0 });                          // call rax
+        }
+
+    private:
+        uint8_t* m_p;
+};
+
+#endif
+
+Dynarec::Dynarec()
+    : m_translations(BlockCache::NUM_BLOCKS),
+      m_code(allocateExecutable(CODE_SIZE)),
+      m_codeUsed(0)
+{
+    m_stats = {};
+    clear();
+}
+
+Dynarec::~Dynarec()
+{
+    freeExecutable(m_code, CODE_SIZE);
+}
+
+void Dynarec::clear()
+{
+    for (Translation& t : m_translations)
+    {
+        t.pc = 0;
+        t.count = 0;
+        t.pageWrites = 0;
+        t.hits = 0;
+        t.code = nullptr;
+    }
+    m_codeUsed = 0;
+}
+
+const Dynarec::Stats& Dynarec::getStats() const
+{
+    return m_stats;
+}
+
+#ifdef Z80_DYNAREC_SUPPORTED
+
+// Generated code keeps Z80* in rbx, the memory in r12, the registers in r13,
+// the cycle count in r14d, the page write counter in r15 and the frame in rbp.
+// These are callee saved in both the System V and the Windows x64 ABI.
+DynarecCode Dynarec::translate(const BasicBlock& block, const BlockCache& cache)
+{
+    Translation& t = m_translations[block.pc & (BlockCache::NUM_BLOCKS - 1)];
+    t.hits = HOT_THRESHOLD + 1;
+    if (!m_code || block.usesPorts || block.count == 0) { return nullptr; }
+
+    if (m_codeUsed + MAX_BLOCK_CODE > CODE_SIZE)
+    {
+        // Stale translations are never freed one by one, start over when full
+        clear();
+        m_stats.flushes++;
+        t.pc = block.pc;
+        t.count = block.count;
+        t.pageWrites = block.pageWrites;
+    }
+
+    uint8_t* start = m_code + m_codeUsed;
+    if (!protect(start, MAX_BLOCK_CODE, false)) { return nullptr; }
+    CodeWriter w(start);
+    const uint8_t pcOffset = (uint8_t) offsetof(Z80Registers, PC);
+
+    // Prologue, 6 pushes and 40 bytes leave rsp 16 byte aligned with shadow space
+    w.bytes({ 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 });
+    w.bytes({ 0x48, 0x83, 0xEC, 0x28 });                // sub rsp, 40
+#ifdef _WIN32
+    w.bytes({ 0x48, 0x89, 0xCD });                      // mov rbp, rcx
+#else
+    w.bytes({ 0x48, 0x89, 0xFD });                      // mov rbp, rdi
+#endif
+    w.bytes({ 0x48, 0x8B, 0x5D, 0x00 });                // mov rbx, [rbp+0]
+    w.bytes({ 0x4C, 0x8B, 0x65, 0x08 });                // mov r12, [rbp+8]
+    w.bytes({ 0x4C, 0x8B, 0x6D, 0x10 });                // mov r13, [rbp+16]
+    w.bytes({ 0x4C, 0x8B, 0x7D, 0x18 });                // mov r15, [rbp+24]
+    w.bytes({ 0x45, 0x31, 0xF6 });                      // xor r14d, r14d
+
+    // Exits are emitted after the block: each sets the instructions run, a
+    // taken jump adds its cycles first
+    struct Exit {
+        uint8_t* from[2];
+        int instructions;
+        int cycles;
+    };
+    Exit exits[4 * BasicBlock::MAX_INSTRUCTIONS];
+    int numExits = 0;
+    uint8_t* labels[BasicBlock::MAX_INSTRUCTIONS + 1];  // Code of each instruction, then the fall through
+    uint8_t* next[BasicBlock::MAX_INSTRUCTIONS];         // jmp to a later label
+    int nextTarget[BasicBlock::MAX_INSTRUCTIONS];
+    int numNext = 0;
+
+    uint16_t pc = block.pc;
+    for (int i = 0; i < block.count; i++)
+    {
+        const PredecodedInstruction& inst = block.instructions[i];
+        labels[i] = w.position();
+
+        // Same rule as Z80::runBlock, the frame can't end inside a superinstruction
+        uint8_t* plain = nullptr;
+        if (inst.superinstruction)
+        {
+            const Superinstruction& super = cache.superinstruction(inst.superinstruction);
+            const int after = i + super.count;
+            const uint16_t superPC = (uint16_t) (pc + super.length);
+
+            w.bytes({ 0x41, 0x8D, 0x86 });              // lea eax, [r14+leadCycles]
+            w.imm32(super.leadCycles);
+            w.bytes({ 0x3B, 0x45, 0x20 });              // cmp eax, [rbp+32]
+            w.bytes({ 0x0F, 0x8F });                    // jg plain
+            plain = w.rel32();
+
+            w.callHandler(super.execute, block.instructions[after - 1].data, superPC, pcOffset);
+            w.bytes({ 0xFF, 0x45, 0x28 });              // inc dword [rbp+40]
+            w.bytes({ 0x83, 0x45, 0x2C, super.count }); // add dword [rbp+44], count
+
+            w.bytes({ 0x66, 0x41, 0x81, 0x7D, pcOffset });  // cmp word [r13+PC], superPC
+            w.imm16(superPC);
+            w.bytes({ 0x0F, 0x85 });                    // jne exit
+            exits[numExits++] = { { w.rel32(), nullptr }, after, super.cyclesOnJump };
+
+            w.bytes({ 0x41, 0x81, 0xC6 });              // add r14d, cycles
+            w.imm32(super.cycles);
+            if (after < block.count)
+            {
+                w.bytes({ 0x41, 0x81, 0x3F });          // cmp dword [r15], pageWrites
+                w.imm32(block.pageWrites);
+                w.bytes({ 0x0F, 0x85 });                // jne exit
+                uint8_t* written = w.rel32();
+                w.bytes({ 0x44, 0x3B, 0x75, 0x20 });    // cmp r14d, [rbp+32]
+                w.bytes({ 0x0F, 0x8F });                // jg exit
+                exits[numExits++] = { { written, w.rel32() }, after, 0 };
+            }
+            w.bytes({ 0xE9 });                          // jmp to the instruction after it
+            next[numNext] = w.rel32();
+            nextTarget[numNext++] = after;
+            CodeWriter::patch(plain, w.position());
+        }
+
+        pc += inst.length;
+        w.callHandler(inst.execute, inst.data, pc, pcOffset);
+
+        w.bytes({ 0x66, 0x41, 0x81, 0x7D, pcOffset });  // cmp word [r13+PC], pc
+        w.imm16(pc);
+        w.bytes({ 0x0F, 0x85 });                        // jne exit
+        exits[numExits++] = { { w.rel32(), nullptr }, i + 1, inst.cyclesOnJump };
+
+        w.bytes({ 0x41, 0x81, 0xC6 });                  // add r14d, cycles
+        w.imm32(inst.cycles);
+
+        if (i + 1 < block.count)
+        {
+            // Self modifying code, the rest of the block may be stale
+            w.bytes({ 0x41, 0x81, 0x3F });              // cmp dword [r15], pageWrites
+            w.imm32(block.pageWrites);
+            w.bytes({ 0x0F, 0x85 });                    // jne exit
+            uint8_t* written = w.rel32();
+            w.bytes({ 0x44, 0x3B, 0x75, 0x20 });        // cmp r14d, [rbp+32]
+            w.bytes({ 0x0F, 0x8F });                    // jg exit
+            exits[numExits++] = { { written, w.rel32() }, i + 1, 0 };
+        }
+    }
+
+    // Fell through the whole block
+    labels[block.count] = w.position();
+    for (int i = 0; i < numNext; i++) { CodeWriter::patch(next[i], labels[nextTarget[i]]); }
+    w.bytes({ 0xC7, 0x45, 0x24 });                      // mov dword [rbp+36], count
+    w.imm32(block.count);
+    w.bytes({ 0xE9 });                                  // jmp epilogue
+    uint8_t* toEpilogue[4 * BasicBlock::MAX_INSTRUCTIONS + 1];
+    int numToEpilogue = 0;
+    toEpilogue[numToEpilogue++] = w.rel32();
+
+    for (int i = 0; i < numExits; i++)
+    {
+        for (uint8_t* from : exits[i].from)
+        {
+            if (from) { CodeWriter::patch(from, w.position()); }
+        }
+        if (exits[i].cycles)
+        {
+            w.bytes({ 0x41, 0x81, 0xC6 });              // add r14d, cycles
+            w.imm32(exits[i].cycles);
+        }
+        w.bytes({ 0xC7, 0x45, 0x24 });                  // mov dword [rbp+36], instructions
+        w.imm32(exits[i].instructions);
+        w.bytes({ 0xE9 });                              // jmp epilogue
+        toEpilogue[numToEpilogue++] = w.rel32();
+    }
+
+    for (int i = 0; i < numToEpilogue; i++)
+    {
+        CodeWriter::patch(toEpilogue[i], w.position());
+    }
+    w.bytes({ 0x44, 0x89, 0xF0 });                      // mov eax, r14d
+    w.bytes({ 0x48, 0x83, 0xC4, 0x28 });                // add rsp, 40
+    w.bytes({ 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B });
+    w.bytes({ 0xC3 });                                  // ret
+
+    if (!protect(start, MAX_BLOCK_CODE, true)) { return nullptr; }
+    m_codeUsed += w.position() - start;
+    m_stats.translations++;
+
+    t.hits = HOT_THRESHOLD;
+    t.code = (DynarecCode) start;
+    return t.code;
+}
+
+#else
+
+DynarecCode Dynarec::translate(const BasicBlock& block, const BlockCache& cache)
+{
+    m_translations[block.pc & (BlockCache::NUM_BLOCKS - 1)].hits = HOT_THRESHOLD + 1;
+    return nullptr;
+}
+
+#endif
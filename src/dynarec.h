@@ -0,0 +1,97 @@
+#ifndef DYNAREC_H
+#define DYNAREC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "defines.h"
+#include "block_cache.h"
+
+// The generated code is x86-64, other hosts only have the interpreter
+#if defined(__x86_64__) || defined(_M_X64)
+    #define Z80_DYNAREC_SUPPORTED
+#endif
+
+struct Z80Registers;
+
+// Passed to a translated block, offsets are fixed since the generated code reads them
+struct DynarecFrame {
+    Z80* z;                             // 0
+    Spectrum48KMemory* m;               // 8
+    Z80Registers* registers;            // 16
+    const uint32_t* pageWrites;         // 24, write counter of the block's page
+    int32_t cycleBudget;                // 32, stop once more cycles than this were taken
+    int32_t instructions;               // 36, set to the number of instructions executed
+    int32_t superinstructions;          // 40, counts the superinstructions run
+    int32_t fused;                      // 44, counts the instructions they covered
+};
+
+// Returns the cycles taken
+typedef int (*DynarecCode)(DynarecFrame*);
+
+// Call threaded code for hot basic blocks from the block cache. No Z80
+// instruction is turned into native ALU code: a translated block is a run of
+// direct calls to the instruction handlers (or to a superinstruction's) with
+// their operands as immediates, and keeps PC, the jump check, the page write
+// check and the cycle count in generated code, matching Z80::runBlock exactly.
+// What it saves is the dispatch loop. Blocks that use I/O ports are left to
+// the interpreter.
+class Dynarec {
+    public:
+        static const int HOT_THRESHOLD = 16;            // Lookups before a block is translated
+        static const size_t CODE_SIZE = 4 * 1024 * 1024;
+
+        struct Stats {
+            uint64_t translations;
+            uint64_t flushes;           // Times the code buffer filled up and was emptied
+            uint64_t instructions;      // Executed from translated code
+        };
+
+        Dynarec();
+        ~Dynarec();
+
+        // Drop every translation
+        void clear();
+
+        // Native code for block, translated once the block is hot. Returns nullptr
+        // while it is cold, when it can't be translated or on unsupported hosts.
+        // cache holds the superinstructions the block refers to.
+        inline DynarecCode lookup(const BasicBlock& block, const BlockCache& cache)
+        {
+            Translation& t = m_translations[block.pc & (BlockCache::NUM_BLOCKS - 1)];
+            if (t.pc != block.pc || t.pageWrites != block.pageWrites || t.count != block.count)
+            {
+                t.pc = block.pc;
+                t.pageWrites = block.pageWrites;
+                t.count = block.count;
+                t.hits = 0;
+                t.code = nullptr;
+            }
+            if (t.code || t.hits > HOT_THRESHOLD || ++t.hits < HOT_THRESHOLD) { return t.code; }
+            return translate(block, cache);
+        }
+
+        inline void countInstructions(int n) { m_stats.instructions += n; }
+
+        const Stats& getStats() const;
+
+    private:
+        struct Translation {
+            uint16_t pc;
+            uint8_t count;
+            uint32_t pageWrites;
+            int hits;                   // HOT_THRESHOLD + 1 when translation failed
+            DynarecCode code;
+        };
+
+        // Emit native code for block and store it in its translation
+        DynarecCode translate(const BasicBlock& block, const BlockCache& cache);
+
+        std::vector<Translation> m_translations;
+        uint8_t* m_code;                // CODE_SIZE bytes, executable except while a block is written
+        size_t m_codeUsed;
+        Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "flag_tables.h"
+
+// Bits of F
+#define F_C     0x01
+#define F_N     0x02
+#define F_PV    0x04
+#define F_X     0x08
+#define F_H     0x10
+#define F_Y     0x20
+#define F_Z     0x40
+#define F_S     0x80
+
+static constexpr int sign8(uint8_t x)
+{
+    return x == 0 ? 0 : (x & 0x80) ? -1 : 1;
+}
+
+// detectOverflow() on the operands as signed bytes, the carry in isn't counted
+static constexpr bool overflow8(uint8_t a, uint8_t b)
+{
+    if (sign8(a) != sign8(b) || a == 0 || b == 0) { return false; }
+    return sign8((uint8_t) (a + b)) != sign8(a);
+}
+
+static constexpr uint8_t signZero8(uint8_t result)
+{
+    return (result & F_S) | (result == 0 ? F_Z : 0);
+}
+
+static constexpr bool evenParity8(uint8_t x)
+{
+    bool even = true;
+    for (int i = 0; i < 8; i++)
+    {
+        if (x & (1 << i)) { even = !even; }
+    }
+    return even;
+}
+
+// add<uint8_t>(a, b, r, ADD8, true) followed by NF = 0
+static constexpr uint8_t addFlags(uint8_t a, uint8_t b, bool carryIn)
+{
+    uint8_t result = a + b + carryIn;
+    bool carry = carryIn ? a >= 0xFF - b : a > 0xFF - b;
+    bool halfCarry = carryIn ? (a & 0xF) >= 0xF - (b & 0xF) : (a & 0xF) > 0xF - (b & 0xF);
+    return signZero8(result) | (halfCarry ? F_H : 0) | (overflow8(a, b) ? F_PV : 0) | (carry ? F_C : 0);
+}
+
+// add<uint8_t>(a, b, r, SUB8, false, true) followed by NF = 1, b is the negated operand
+static constexpr uint8_t subFlags(uint8_t a, uint8_t b, bool borrowIn)
+{
+    uint8_t result = a + b - borrowIn;
+    uint8_t operand = -b;
+    uint8_t difference = a - operand;
+    bool borrow = operand > a || (borrowIn && difference == 0);
+    bool halfBorrow = (operand & 0xF) > (a & 0xF) || (borrowIn && (difference & 0xF) == 0);
+    return signZero8(result) | (halfBorrow ? F_H : 0) | (overflow8(a, b) ? F_PV : 0) | F_N | (borrow ? F_C : 0);
+}
+
+static constexpr uint16_t daaValue(bool C, bool H, bool N, uint8_t A)
+{
+    // daaCarry()
+    bool carry = C || (!((A & 0xF) < 10 && (A & 0xF0) < 0xA0) && !((A & 0xF) > 9 && (A & 0xF0) < 0x90));
+    // daaHalfCarry()
+    bool halfCarry = !N ? (A & 0xF) >= 10 : H && (A & 0xF) <= 5;
+
+    uint8_t result = A;
+    if ((A & 0xF) > 9 || H) { result = N ? result - 0x06 : result + 0x06; }
+    if (A > 0x99 || C) { result = N ? result - 0x60 : result + 0x60; }
+
+    uint8_t f = signZero8(result) | (result & (F_X | F_Y)) | (evenParity8(result) ? F_PV : 0) |
+                (halfCarry ? F_H : 0) | (N ? F_N : 0) | (carry ? F_C : 0);
+    return (uint16_t) (result << 8) | f;
+}
+
+static constexpr FlagTables buildFlagTables()
+{
+    FlagTables t = {};
+    for (int a = 0; a < 256; a++)
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            for (int c = 0; c < 2; c++)
+            {
+                t.add[c][a][b] = addFlags(a, b, c);
+                t.sub[c][a][b] = subFlags(a, b, c);
+            }
+        }
+
+        // The half carry of a + 1 and the half borrow of a + 0xFF
+        t.inc[a] = signZero8(a + 1) | ((a & 0xF) == 0xF ? F_H : 0) | (a == 0x7F ? F_PV : 0);
+        t.dec[a] = signZero8(a - 1) | ((a & 0xF) == 0 ? F_H : 0) | (a == 0x80 ? F_PV : 0) | F_N;
+        t.logic[a] = signZero8(a) | (evenParity8(a) ? F_PV : 0);
+
+        for (int chn = 0; chn < 8; chn++)
+        {
+            t.daa[chn][a] = daaValue(chn & 1, chn & 2, chn & 4, a);
+        }
+    }
+    return t;
+}
+
+constexpr FlagTables flagTables = buildFlagTables();
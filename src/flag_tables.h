@@ -0,0 +1,25 @@
+#ifndef FLAG_TABLES_H
+#define FLAG_TABLES_H
+
+#include <stdint.h>
+
+// F after each 8-bit ALU operation, generated at compile time from the same
+// rules as add(), bitwiseAnd/Xor/Or() and the DAA helpers in utils.h. An entry
+// holds every flag the operation writes, so F is updated with one table load
+// merged into the bits the operation keeps.
+struct FlagTables {
+    static constexpr uint8_t ALU_WRITTEN = 0xD7;        // S Z H PV N C, XF/YF are kept
+    static constexpr uint8_t INC_DEC_WRITTEN = 0xD6;    // INC/DEC also keep CF
+    static constexpr uint8_t AND_HALF_CARRY = 0x10;
+
+    uint8_t add[2][256][256];   // [carry in][a][b], ADD/ADC
+    uint8_t sub[2][256][256];   // [borrow in][a][b], SUB/SBC/CP with b negated as passed to add()
+    uint8_t inc[256];
+    uint8_t dec[256];
+    uint8_t logic[256];         // XOR/OR of a result, AND adds AND_HALF_CARRY
+    uint16_t daa[8][256];       // [C | H << 1 | N << 2][A], AF after DAA
+};
+
+extern const FlagTables flagTables;
+
+#endif
@@ -12,18 +12,46 @@ class Z80;
 
 enum class MachineCycleType { UNUSED, M1R, MRD, MWR, IOR, IOW, NON };
 
+#define MAX_DATA_BYTES 2
+#define MAX_MNEMONIC_LENGTH 16      // Including the terminating zero
+
+// Operand bytes of an instruction, passed by value to avoid allocating
+struct InstructionData {
+    uint8_t bytes[MAX_DATA_BYTES];
+
+    inline uint8_t operator[](int i) const { return bytes[i]; }
+};
+
+typedef void (*InstructionHandler)(Z80*, Spectrum48KMemory*, InstructionData);
+
 struct Instruction {
     int cycles;                 
     int cyclesOnJump;          
     int numDataBytes;           
 
-    void (*execute)(Z80*, Spectrum48KMemory*, std::vector<uint8_t>);
+    InstructionHandler execute;
 
     int cntMachineCycles;       
 
     MachineCycleType machineCycles[7];  
     int machineCycleTimes[7];   
-    std::string mnemonic;
+    char mnemonic[MAX_MNEMONIC_LENGTH];
+};
+
+// Part of an instruction needed to execute it, packed so several share a cache line
+struct InstructionHot {
+    InstructionHandler execute;
+    uint8_t cycles;
+    uint8_t cyclesOnJump;
+    uint8_t numDataBytes;
+};
+
+// Part of an instruction only used by the debugger and tests
+struct InstructionInfo {
+    int cntMachineCycles;
+    MachineCycleType machineCycles[7];
+    int machineCycleTimes[7];
+    char mnemonic[MAX_MNEMONIC_LENGTH];
 };
 
 #endif
\ No newline at end of file
@@ -10,6 +10,7 @@
 
 #include "defines.h"
 #include "instruction.h"
+#include "micro_ops.h"
 
 // Instruction opcode has up to 3 bytes
 typedef std::tuple<uint8_t, uint8_t, uint8_t> opcode;
@@ -36,9 +37,20 @@ struct hash<opcode>{
 }
 
 // Instruction lambda signature
-#define INST [](Z80* z, Spectrum48KMemory* m, std::vector<uint8_t> d)
+#define INST [](Z80* z, Spectrum48KMemory* m, InstructionData d)
 
-// Create the instruction set
-std::shared_ptr<std::array<Instruction, NUM_INSTRUCTIONS>> z80InstructionSet();
+// The instruction set, built at compile time and shared by every Z80
+const std::array<Instruction, NUM_INSTRUCTIONS>& z80InstructionSet();
+
+// Instruction set split into the data used for dispatch and the metadata,
+// with each instruction also lowered to the micro-ops of its bus cycles
+struct InstructionTable {
+    std::array<InstructionHot, NUM_INSTRUCTIONS> hot;
+    std::array<InstructionInfo, NUM_INSTRUCTIONS> cold;
+    std::array<MicroProgram, NUM_INSTRUCTIONS> micro;
+};
+
+// The instruction set in its split form, also built at compile time
+const InstructionTable& z80InstructionTable();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,235 @@
+#ifndef MICRO_OPS_H
+#define MICRO_OPS_H
+
+#include <stdint.h>
+
+#include "instruction.h"
+
+// Step of an instruction lowered from its machineCycles[] metadata. Each
+// machine cycle becomes one bus access, EXECUTE runs the instruction handler.
+enum class MicroOpType : uint8_t { FETCH, READ, WRITE, PORT_READ, PORT_WRITE, INTERNAL, EXECUTE };
+
+// What the address of an access is computed from. Registers are taken from
+// before the instruction runs, PC is the address of its first opcode byte.
+enum class AddressSource : uint8_t {
+    NONE,
+    PC,
+    BC,
+    DE,
+    HL,
+    SP,
+    IX_D,           // IX plus the displacement operand
+    IY_D,
+    OPERAND,        // nn
+    PORT_N          // A in the high byte, the operand n in the low one
+};
+
+struct MicroOp {
+    MicroOpType type;
+    AddressSource source;
+    int8_t offset;              // Added to the source address
+    uint8_t tstate;             // Start relative to the instruction
+};
+
+// Conditional instructions EXECUTE once the cycles they always take are
+// issued, the ops after it only run when the jump is taken
+struct MicroProgram {
+    static const int MAX_OPS = 8;       // 7 machine cycles and EXECUTE
+
+    uint8_t count;                      // 0 for unused opcodes
+    MicroOp ops[MAX_OPS];
+};
+
+// Observes the bus while instructions run as micro-ops, see Z80::setBusListener
+class IBusListener {
+    public:
+        virtual ~IBusListener() {}
+
+        // A machine cycle of length T-states starting at tstate (frame relative).
+        // Returns the wait states inserted in it, which delay every later cycle.
+        virtual int busCycle(MicroOpType type, uint16_t address, int tstate, int length) = 0;
+};
+
+static constexpr bool mnemonicContains(const char* s, const char* pattern)
+{
+    for (int i = 0; s[i]; i++)
+    {
+        int j = 0;
+        while (pattern[j] && s[i + j] == pattern[j]) { j++; }
+        if (!pattern[j]) { return true; }
+    }
+    return false;
+}
+
+// First word of the mnemonic is name
+static constexpr bool mnemonicIs(const char* s, const char* name)
+{
+    int i = 0;
+    while (name[i] && s[i] == name[i]) { i++; }
+    return !name[i] && (s[i] == 0 || s[i] == ' ');
+}
+
+static constexpr bool mnemonicIsAny(const char* s, const char* const* names, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (mnemonicIs(s, names[i])) { return true; }
+    }
+    return false;
+}
+
+// Where the data accesses of an instruction go, each further access of the
+// same direction moves by step
+struct DataAddressing {
+    AddressSource read = AddressSource::NONE;
+    int8_t readOffset = 0;
+    int8_t readStep = 0;
+    AddressSource write = AddressSource::NONE;
+    int8_t writeOffset = 0;
+    int8_t writeStep = 0;
+    AddressSource port = AddressSource::NONE;
+};
+
+static constexpr DataAddressing dataAddressing(const char* mnemonic)
+{
+    const char* const pushes[] = { "PUSH", "CALL", "RST" };
+    const char* const pops[] = { "POP", "RET", "RETI", "RETN" };
+    const char* const blockLoads[] = { "LDI", "LDD", "LDIR", "LDDR" };
+    const char* const blockCompares[] = { "CPI", "CPD", "CPIR", "CPDR" };
+    const char* const blockInputs[] = { "INI", "IND", "INIR", "INDR" };
+    const char* const blockOutputs[] = { "OUTI", "OUTD", "OTIR", "OTDR" };
+
+    DataAddressing a;
+    auto both = [&a](AddressSource source) { a.read = source; a.write = source; };
+
+    if (mnemonicContains(mnemonic, "(IX+d)")) { both(AddressSource::IX_D); }
+    else if (mnemonicContains(mnemonic, "(IY+d)")) { both(AddressSource::IY_D); }
+    else if (mnemonicContains(mnemonic, "(HL)") || mnemonicIs(mnemonic, "RLD") || mnemonicIs(mnemonic, "RRD"))
+    {
+        both(AddressSource::HL);
+    }
+    else if (mnemonicContains(mnemonic, "(BC)")) { both(AddressSource::BC); }
+    else if (mnemonicContains(mnemonic, "(DE)")) { both(AddressSource::DE); }
+    else if (mnemonicContains(mnemonic, "(nn)"))
+    {
+        both(AddressSource::OPERAND);
+        a.readStep = a.writeStep = 1;
+    }
+    else if (mnemonicContains(mnemonic, "(SP)"))
+    {
+        // EX (SP),HL reads low then high and writes back high then low
+        both(AddressSource::SP);
+        a.readStep = 1;
+        a.writeOffset = 1;
+        a.writeStep = -1;
+    }
+    else if (mnemonicIsAny(mnemonic, pushes, 3))
+    {
+        a.write = AddressSource::SP;
+        a.writeOffset = -1;
+        a.writeStep = -1;
+    }
+    else if (mnemonicIsAny(mnemonic, pops, 4))
+    {
+        a.read = AddressSource::SP;
+        a.readStep = 1;
+    }
+    else if (mnemonicIsAny(mnemonic, blockLoads, 4))
+    {
+        a.read = AddressSource::HL;
+        a.write = AddressSource::DE;
+    }
+    else if (mnemonicIsAny(mnemonic, blockCompares, 4) || mnemonicIsAny(mnemonic, blockOutputs, 4))
+    {
+        a.read = AddressSource::HL;
+    }
+    else if (mnemonicIsAny(mnemonic, blockInputs, 4))
+    {
+        a.write = AddressSource::HL;
+    }
+
+    if (mnemonicContains(mnemonic, "(C)") || mnemonicIsAny(mnemonic, blockInputs, 4) || mnemonicIsAny(mnemonic, blockOutputs, 4))
+    {
+        a.port = AddressSource::BC;
+    }
+    else if (mnemonicContains(mnemonic, "(n)"))
+    {
+        a.port = AddressSource::PORT_N;
+    }
+    return a;
+}
+
+// Lower instruction index of the instruction set. Opcode and operand bytes are
+// fetched in order from PC, DDCB/FDCB read their opcode after the displacement.
+// Internal cycles keep the previous address on the bus.
+static constexpr MicroProgram lowerInstruction(const Instruction& inst, int index)
+{
+    MicroProgram program = {};
+    if (!inst.execute) { return program; }
+
+    const DataAddressing data = dataAddressing(inst.mnemonic);
+    const int streamReads = inst.numDataBytes + (index >= 2304 ? 1 : 0);
+    int fetches = 0;
+    int streamed = 0;
+    int reads = 0;
+    int writes = 0;
+    int tstate = 0;
+    bool executed = false;
+    MicroOp previous = {};
+
+    for (int i = 0; i < inst.cntMachineCycles; i++)
+    {
+        if (!executed && tstate >= inst.cycles)
+        {
+            program.ops[program.count++] = { MicroOpType::EXECUTE, AddressSource::NONE, 0, (uint8_t) tstate };
+            executed = true;
+        }
+
+        MicroOp op = { MicroOpType::INTERNAL, previous.source, previous.offset, (uint8_t) tstate };
+        switch (inst.machineCycles[i])
+        {
+            case MachineCycleType::M1R:
+                op.type = MicroOpType::FETCH;
+                op.source = AddressSource::PC;
+                op.offset = fetches++;
+                break;
+            case MachineCycleType::MRD:
+                op.type = MicroOpType::READ;
+                if (streamed < streamReads)
+                {
+                    op.source = AddressSource::PC;
+                    op.offset = fetches + streamed++;
+                }
+                else
+                {
+                    op.source = data.read;
+                    op.offset = data.readOffset + data.readStep * reads++;
+                }
+                break;
+            case MachineCycleType::MWR:
+                op.type = MicroOpType::WRITE;
+                op.source = data.write;
+                op.offset = data.writeOffset + data.writeStep * writes++;
+                break;
+            case MachineCycleType::IOR:
+            case MachineCycleType::IOW:
+                op.type = inst.machineCycles[i] == MachineCycleType::IOR ? MicroOpType::PORT_READ : MicroOpType::PORT_WRITE;
+                op.source = data.port;
+                op.offset = 0;
+                break;
+            default:
+                break;
+        }
+        program.ops[program.count++] = op;
+        previous = op;
+        tstate += inst.machineCycleTimes[i];
+    }
+
+    if (!executed)
+    {
+        program.ops[program.count++] = { MicroOpType::EXECUTE, AddressSource::NONE, 0, (uint8_t) tstate };
+    }
+    return program;
+}
+
+#endif
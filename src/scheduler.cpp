@@ -0,0 +1,64 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler()
+    : m_next(NEVER)
+{
+}
+
+Scheduler::EventId Scheduler::addEvent(IEventHandler* handler)
+{
+    m_events.push_back({ NEVER, handler });
+    return (EventId) m_events.size() - 1;
+}
+
+void Scheduler::schedule(EventId id, uint64_t tstate)
+{
+    m_events[id].deadline = tstate;
+    updateNext();
+}
+
+void Scheduler::cancel(EventId id)
+{
+    schedule(id, NEVER);
+}
+
+void Scheduler::cancelAll()
+{
+    for (Event& event : m_events)
+    {
+        event.deadline = NEVER;
+    }
+    m_next = NEVER;
+}
+
+uint64_t Scheduler::getDeadline(EventId id) const
+{
+    return m_events[id].deadline;
+}
+
+void Scheduler::dispatch(uint64_t tstate)
+{
+    while (m_next <= tstate)
+    {
+        for (Event& event : m_events)
+        {
+            if (event.deadline == m_next)
+            {
+                uint64_t deadline = event.deadline;
+                event.deadline = NEVER;
+                event.handler->handleEvent(deadline);
+                break;
+            }
+        }
+        updateNext();
+    }
+}
+
+void Scheduler::updateNext()
+{
+    m_next = NEVER;
+    for (const Event& event : m_events)
+    {
+        if (event.deadline < m_next) { m_next = event.deadline; }
+    }
+}
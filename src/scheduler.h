@@ -0,0 +1,57 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <vector>
+
+// Work a component wants done at a T-state, see Scheduler::addEvent
+class IEventHandler {
+    public:
+        virtual ~IEventHandler() {}
+
+        // The clock reached deadline. Called between instructions, so the clock
+        // may be up to one instruction past it.
+        virtual void handleEvent(uint64_t deadline) = 0;
+};
+
+// Events keyed by the T-state clock of Z80::getTStates. Each registered event
+// is pending at most once, the CPU runs straight up to the earliest deadline.
+class Scheduler {
+    public:
+        typedef int EventId;
+        static const uint64_t NEVER = UINT64_MAX;
+
+        Scheduler();
+
+        // Register an event, not pending until scheduled. Done once at setup,
+        // this is the only call that allocates.
+        EventId addEvent(IEventHandler* handler);
+
+        // Replace the deadline of id. A handler rescheduling its own event must
+        // pick a later deadline than the one it was called for.
+        void schedule(EventId id, uint64_t tstate);
+        void cancel(EventId id);
+        // Cancel every event, the clock was reset
+        void cancelAll();
+
+        uint64_t getDeadline(EventId id) const;
+        inline uint64_t nextDeadline() const { return m_next; }
+
+        // Call the handlers due by tstate, earliest first and in the order the
+        // events were added on ties
+        void dispatch(uint64_t tstate);
+
+    private:
+        struct Event {
+            uint64_t deadline;
+            IEventHandler* handler;
+        };
+
+        void updateNext();
+
+        // A handful of sources, scanning them beats keeping a heap in order
+        std::vector<Event> m_events;
+        uint64_t m_next;
+};
+
+#endif
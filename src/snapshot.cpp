@@ -0,0 +1,151 @@
+#include "snapshot.h"
+
+Snapshots::Snapshots(Z80* cpu, Spectrum48KMemory* memory)
+    : m_cpu(cpu), m_memory(memory), m_nextId(0)
+{
+    m_memory->pageSaver = this;
+}
+
+Snapshots::~Snapshots()
+{
+    m_memory->pageSaver = nullptr;
+}
+
+Snapshots::Id Snapshots::take()
+{
+    std::unique_ptr<Snapshot> snapshot(new Snapshot());
+    snapshot->id = m_nextId++;
+    snapshot->cpu = m_cpu->saveState();
+    for (int slot = 0; slot < Spectrum48KMemory::NUM_SLOTS; slot++)
+    {
+        snapshot->readSlots[slot] = m_memory->readSlots[slot];
+        snapshot->writeSlots[slot] = m_memory->writeSlots[slot];
+    }
+    snapshot->screenMemory = m_memory->screenMemory;
+    snapshot->pagingState = m_memory->pagingState;
+
+    m_snapshots.push_back(std::move(snapshot));
+    newEpoch();
+    return m_snapshots.back()->id;
+}
+
+bool Snapshots::restore(Id id)
+{
+    int position = find(id);
+    if (position < 0) { return false; }
+
+    // Newest first, so a page saved by several snapshots ends up as the oldest
+    // of them saw it, the state at id
+    for (int i = (int) m_snapshots.size() - 1; i >= position; i--)
+    {
+        for (const SavedPage& saved : m_snapshots[i]->pages) { writeBack(saved); }
+    }
+    m_snapshots.resize(position + 1);
+
+    Snapshot& snapshot = *m_snapshots[position];
+    for (int slot = 0; slot < Spectrum48KMemory::NUM_SLOTS; slot++)
+    {
+        m_memory->mapSlot(slot, snapshot.readSlots[slot], snapshot.writeSlots[slot] != m_memory->sink);
+    }
+    if (m_memory->screenMemory != snapshot.screenMemory) { m_memory->markScreenDirty(); }
+    m_memory->screenMemory = snapshot.screenMemory;
+    m_memory->screenColorData = snapshot.screenMemory + Spectrum48KMemory::SCREEN_PIXEL_BYTES;
+    m_memory->pagingState = snapshot.pagingState;
+    m_cpu->loadState(snapshot.cpu);
+
+    // The machine matches id again, nothing is held until the next writes
+    snapshot.pages.clear();
+    snapshot.index.clear();
+    newEpoch();
+    return true;
+}
+
+void Snapshots::release(Id id)
+{
+    int position = find(id);
+    if (position < 0) { return; }
+
+    // A page the previous snapshot doesn't hold wasn't written between the two,
+    // so the copy is what it saw as well
+    if (position > 0)
+    {
+        Snapshot& previous = *m_snapshots[position - 1];
+        for (const SavedPage& saved : m_snapshots[position]->pages)
+        {
+            if (previous.index.count(saved.page)) { continue; }
+            previous.index[saved.page] = previous.pages.size();
+            previous.pages.push_back(saved);
+        }
+    }
+    m_snapshots.erase(m_snapshots.begin() + position);
+}
+
+void Snapshots::releaseAll()
+{
+    m_snapshots.clear();
+}
+
+int Snapshots::getPagesHeld(Id id) const
+{
+    int position = find(id);
+    return position < 0 ? 0 : (int) m_snapshots[position]->pages.size();
+}
+
+size_t Snapshots::getBytesHeld(Id id) const
+{
+    int position = find(id);
+    if (position < 0) { return 0; }
+    const Snapshot& snapshot = *m_snapshots[position];
+    return sizeof(Snapshot) + snapshot.pages.capacity() * sizeof(SavedPage) +
+        snapshot.index.size() * (sizeof(const uint8_t*) + sizeof(size_t));
+}
+
+void Snapshots::savePage(uint8_t* page)
+{
+    if (m_snapshots.empty()) { return; }
+
+    // After a release the newest snapshot may be asked for a page it has
+    Snapshot& newest = *m_snapshots.back();
+    if (newest.index.count(page)) { return; }
+    newest.index[page] = newest.pages.size();
+    newest.pages.push_back(SavedPage());
+    SavedPage& saved = newest.pages.back();
+    saved.page = page;
+    memcpy(saved.data, page, Spectrum48KMemory::PAGE_SIZE);
+}
+
+int Snapshots::find(Id id) const
+{
+    for (int i = 0; i < (int) m_snapshots.size(); i++)
+    {
+        if (m_snapshots[i]->id == id) { return i; }
+    }
+    return -1;
+}
+
+void Snapshots::newEpoch()
+{
+    uint32_t epoch = ++m_memory->snapshotEpoch;
+    // Nothing reads the sink, its pages are never worth saving
+    for (uint32_t& mark : m_memory->pageMarks[Spectrum48KMemory::MAX_BANKS]) { mark = epoch; }
+}
+
+void Snapshots::writeBack(const SavedPage& saved)
+{
+    memcpy(saved.page, saved.data, Spectrum48KMemory::PAGE_SIZE);
+
+    for (int slot = 0; slot < Spectrum48KMemory::NUM_SLOTS; slot++)
+    {
+        uintptr_t offset = (uintptr_t) saved.page - (uintptr_t) m_memory->readSlots[slot];
+        if (offset >= Spectrum48KMemory::SLOT_SIZE) { continue; }
+        int page = (slot << (Spectrum48KMemory::SLOT_SHIFT - Spectrum48KMemory::PAGE_SHIFT)) +
+            (int) (offset >> Spectrum48KMemory::PAGE_SHIFT);
+        m_memory->pageWrites[page]++;
+    }
+    for (int bank = 0; bank < m_memory->numBanks; bank++)
+    {
+        uintptr_t offset = (uintptr_t) saved.page - (uintptr_t) m_memory->banks[bank];
+        if (offset < Spectrum48KMemory::SLOT_SIZE) { m_memory->bankWrites[bank][offset >> Spectrum48KMemory::PAGE_SHIFT]++; }
+    }
+    for (int i = 0; i < Spectrum48KMemory::PAGE_SIZE; i++) { m_memory->markScreenWrite(saved.page + i); }
+}
@@ -0,0 +1,80 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "Memory.h"
+#include "Z80.h"
+
+// Copy-on-write snapshots of the CPU and memory, for search and rollback.
+// Taking one copies the CPU state and the page table only, every 256 byte page
+// stays shared with the running machine until its first write, which copies
+// the old contents into the newest snapshot. Restoring copies back the pages
+// written since, so both cost O(pages touched) instead of every bank.
+//
+// Writes to memory[] directly (see touchAll) aren't seen, and scheduled events
+// other than the frame interrupt aren't saved. One instance per memory.
+class Snapshots : public IPageSaver {
+    public:
+        typedef int Id;
+
+        Snapshots(Z80* cpu, Spectrum48KMemory* memory);
+        ~Snapshots();
+
+        // Registered with the memory
+        Snapshots(const Snapshots&) = delete;
+        Snapshots& operator=(const Snapshots&) = delete;
+
+        // Snapshot the machine as it is now
+        Id take();
+        // Put the machine back to id and release the snapshots taken after it,
+        // id stays live. Returns false if id isn't live.
+        bool restore(Id id);
+        // Drop id, the pages it holds move to the snapshot before it when that
+        // one still needs them
+        void release(Id id);
+        void releaseAll();
+
+        int getLiveSnapshots() const { return (int) m_snapshots.size(); }
+        // Pages id holds its own copy of, 0 for unknown ids
+        int getPagesHeld(Id id) const;
+        // Bytes held by id: its page copies and their bookkeeping, 0 for unknown ids
+        size_t getBytesHeld(Id id) const;
+
+        void savePage(uint8_t* page) override;
+
+    private:
+        struct SavedPage {
+            uint8_t* page;
+            uint8_t data[Spectrum48KMemory::PAGE_SIZE];
+        };
+
+        struct Snapshot {
+            Id id;
+            Z80State cpu;
+            uint8_t* readSlots[Spectrum48KMemory::NUM_SLOTS];
+            uint8_t* writeSlots[Spectrum48KMemory::NUM_SLOTS];
+            uint8_t* screenMemory;
+            uint8_t pagingState;
+            std::vector<SavedPage> pages;
+            std::unordered_map<const uint8_t*, size_t> index;   // Page to its entry in pages
+        };
+
+        // Position of id in m_snapshots, -1 if it isn't live
+        int find(Id id) const;
+        // Start saving pages again on their next write
+        void newEpoch();
+        // Copy saved back and count a write in the pages that show it
+        void writeBack(const SavedPage& saved);
+
+        Z80* m_cpu;
+        Spectrum48KMemory* m_memory;
+        std::vector<std::unique_ptr<Snapshot>> m_snapshots;    // Oldest first
+        Id m_nextId;
+};
+
+#endif
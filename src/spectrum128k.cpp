@@ -0,0 +1,53 @@
+#include "spectrum128k.h"
+
+Spectrum128KMemory::Spectrum128KMemory()
+{
+    memset(rom, 0, sizeof(rom));
+    memset(ram, 0, sizeof(ram));
+
+    numBanks = 0;
+    for (int i = 0; i < NUM_ROMS; i++) { banks[numBanks++] = rom[i]; }
+    for (int i = 0; i < NUM_RAM_BANKS; i++) { banks[numBanks++] = ram[i]; }
+
+    ROM = rom[0];
+    printerBuffer = &ram[5][0x1B00];
+    systemVariables = &ram[5][0x1C00];
+    userMemory = &ram[5][0x1CCB];
+    mapSlot(1, ram[5], true);
+    mapSlot(2, ram[2], true);
+    resetPaging();
+}
+
+void Spectrum128KMemory::setPaging(uint8_t value)
+{
+    if (pagingState & 0x20) { return; }
+
+    pagingState = value;
+    mapSlot(0, rom[(value >> 4) & 1], false);
+    mapSlot(3, ram[value & 0x07], true);
+    uint8_t* screen = ram[(value & 0x08) ? 7 : 5];
+    if (screen != screenMemory) { markScreenDirty(); }
+    screenMemory = screen;
+    screenColorData = screenMemory + 0x1800;
+}
+
+void Spectrum128KMemory::resetPaging()
+{
+    pagingState = 0;
+    setPaging(0);
+}
+
+Spectrum128KPaging::Spectrum128KPaging(Spectrum128KMemory* memory)
+    : m_memory(memory)
+{
+}
+
+void Spectrum128KPaging::receiveData(uint8_t data, uint16_t port)
+{
+    if ((port & 0x8002) == 0) { m_memory->setPaging(data); }
+}
+
+bool Spectrum128KPaging::sendData(uint8_t& out, uint16_t port)
+{
+    return false;
+}
@@ -0,0 +1,43 @@
+#ifndef SPECTRUM128K_H
+#define SPECTRUM128K_H
+
+#include <stdint.h>
+
+#include "Memory.h"
+#include "devices.h"
+
+// Memory of the 128K: two ROMs (the 128K editor, then 48K BASIC) and eight RAM
+// banks. Slot 1 always shows bank 5, slot 2 bank 2 and slot 3 the bank picked
+// through port 7FFDh. Paging only moves slot pointers, nothing is copied, and
+// memory[] of the 48K is left unused.
+struct Spectrum128KMemory : public Spectrum48KMemory {
+    static const int NUM_ROMS = 2;
+    static const int NUM_RAM_BANKS = 8;
+
+    uint8_t rom[NUM_ROMS][SLOT_SIZE];       // Contiguous, so a 32K ROM image loads through ROM
+    uint8_t ram[NUM_RAM_BANKS][SLOT_SIZE];
+
+    Spectrum128KMemory();
+
+    // A write to port 7FFDh: bits 0-2 pick the RAM bank at C000h, bit 3 shows
+    // the shadow screen in bank 7, bit 4 picks the ROM and bit 5 ignores every
+    // later write until resetPaging()
+    void setPaging(uint8_t value);
+    // Power on paging, ROM 0 and bank 0, unlocked
+    void resetPaging();
+};
+
+// Port 7FFDh, decoded on A15 and A1 low like the real machine
+class Spectrum128KPaging : public IDevice {
+    public:
+        Spectrum128KPaging(Spectrum128KMemory* memory);
+
+        void receiveData(uint8_t data, uint16_t port) override;
+        // Write only
+        bool sendData(uint8_t& out, uint16_t port) override;
+
+    private:
+        Spectrum128KMemory* m_memory;
+};
+
+#endif
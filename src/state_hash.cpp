@@ -0,0 +1,200 @@
+#include "state_hash.h"
+#include "Z80.h"
+
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define STATE_HASH_SSE2
+#endif
+
+static const int PAGE_WORDS = StateHash::PAGE_SIZE / 8;
+static const int LANES = 4;                 // Accumulators, two SSE2 registers
+static const uint64_t GOLDEN = 0x9E3779B97F4A7C15ULL;
+
+// Secret mixed into every word of a page, so moving a byte changes the hash
+struct PageKey {
+    alignas(16) uint64_t words[PAGE_WORDS];
+};
+
+static constexpr PageKey makePageKey()
+{
+    // splitmix64
+    PageKey key = {};
+    uint64_t x = 0x5A58537065637472ULL;
+    for (int i = 0; i < PAGE_WORDS; i++)
+    {
+        x += GOLDEN;
+        uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        key.words[i] = z ^ (z >> 31);
+    }
+    return key;
+}
+
+static constexpr PageKey pageKey = makePageKey();
+
+// Murmur3 finalizer of h combined with v
+static inline uint64_t mix(uint64_t h, uint64_t v)
+{
+    h = (h ^ v) + GOLDEN;
+    h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCDULL;
+    h = (h ^ (h >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+    return h ^ (h >> 33);
+}
+
+// Little endian on every host
+static inline uint64_t loadWord(const uint8_t* p)
+{
+    uint64_t w = 0;
+    for (int i = 7; i >= 0; i--) { w = (w << 8) | p[i]; }
+    return w;
+}
+
+static uint64_t finishPage(const uint64_t acc[LANES], int page)
+{
+    uint64_t h = mix(0, (uint64_t) page);
+    for (int lane = 0; lane < LANES; lane++) { h = mix(h, acc[lane]); }
+    return h;
+}
+
+// Position of bank in m.banks, 0xFF for the sink or anything else
+static int bankIndex(const Spectrum48KMemory& m, const uint8_t* bank)
+{
+    int index = m.bankIndexOf(bank);
+    return index == Spectrum48KMemory::MAX_BANKS ? 0xFF : index;
+}
+
+StateHash::StateHash()
+{
+    reset();
+}
+
+void StateHash::reset()
+{
+    m_valid = false;
+    for (bool& valid : m_bankValid) { valid = false; }
+    m_chain = 0;
+    m_frames = 0;
+    m_pagesHashed = 0;
+}
+
+uint64_t StateHash::hashPageScalar(const uint8_t* data, int page)
+{
+    // Each word adds the product of the halves of it xor the key, and itself
+    uint64_t acc[LANES] = {};
+    for (int i = 0; i < PAGE_WORDS; i++)
+    {
+        uint64_t word = loadWord(data + 8 * i);
+        uint64_t keyed = word ^ pageKey.words[i];
+        acc[i % LANES] += (keyed & 0xFFFFFFFF) * (keyed >> 32) + word;
+    }
+    return finishPage(acc, page);
+}
+
+uint64_t StateHash::hashPage(const uint8_t* data, int page)
+{
+#ifdef STATE_HASH_SSE2
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    for (int i = 0; i < PAGE_WORDS; i += LANES)
+    {
+        __m128i data0 = _mm_loadu_si128((const __m128i*) (data + 8 * i));
+        __m128i data1 = _mm_loadu_si128((const __m128i*) (data + 8 * i + 16));
+        __m128i keyed0 = _mm_xor_si128(data0, _mm_load_si128((const __m128i*) &pageKey.words[i]));
+        __m128i keyed1 = _mm_xor_si128(data1, _mm_load_si128((const __m128i*) &pageKey.words[i + 2]));
+        __m128i product0 = _mm_mul_epu32(keyed0, _mm_srli_epi64(keyed0, 32));
+        __m128i product1 = _mm_mul_epu32(keyed1, _mm_srli_epi64(keyed1, 32));
+        acc0 = _mm_add_epi64(acc0, _mm_add_epi64(product0, data0));
+        acc1 = _mm_add_epi64(acc1, _mm_add_epi64(product1, data1));
+    }
+    alignas(16) uint64_t acc[LANES];
+    _mm_store_si128((__m128i*) &acc[0], acc0);
+    _mm_store_si128((__m128i*) &acc[2], acc1);
+    return finishPage(acc, page);
+#else
+    return hashPageScalar(data, page);
+#endif
+}
+
+uint64_t StateHash::update(Z80& cpu, const Spectrum48KMemory& m)
+{
+    m_pagesHashed = 0;
+    for (int p = 0; p < NUM_PAGES; p++)
+    {
+        if (m_valid && m.pageWrites[p] == m_pageWrites[p]) { continue; }
+        m_pageHashes[p] = hashPage(m.readPointer((uint16_t) (p * PAGE_SIZE)), p);
+        m_pageWrites[p] = m.pageWrites[p];
+        m_pagesHashed++;
+    }
+    m_valid = true;
+
+    uint64_t h = 0;
+    for (int p = 0; p < NUM_PAGES; p++) { h = mix(h, m_pageHashes[p]); }
+
+    // Banks paged out of every slot, their writes are counted while they're
+    // paged in as well so the hashes stay good across paging
+    for (int bank = 0; bank < m.numBanks; bank++)
+    {
+        bool mapped = false;
+        for (int slot = 0; slot < Spectrum48KMemory::NUM_SLOTS; slot++) { mapped |= m.readSlots[slot] == m.banks[bank]; }
+        if (mapped) { continue; }
+        for (int page = 0; page < Spectrum48KMemory::BANK_PAGES; page++)
+        {
+            if (!m_bankValid[bank] || m.bankWrites[bank][page] != m_bankWrites[bank][page])
+            {
+                m_bankHashes[bank][page] = hashPage(m.banks[bank] + page * PAGE_SIZE, bank << 8 | page);
+                m_bankWrites[bank][page] = m.bankWrites[bank][page];
+                m_pagesHashed++;
+            }
+            h = mix(h, m_bankHashes[bank][page]);
+        }
+        m_bankValid[bank] = true;
+    }
+    for (int slot = 0; slot < Spectrum48KMemory::NUM_SLOTS; slot++)
+    {
+        h = mix(h, bankIndex(m, m.readSlots[slot]) | bankIndex(m, m.writeSlots[slot]) << 8);
+    }
+    h = mix(h, bankIndex(m, m.screenMemory) | m.pagingState << 8);
+
+    const Z80Registers* r = cpu.getRegisters();
+    const uint16_t registers[] = {
+        r->PC, r->SP, r->IX.word, r->IY.word, r->IR.word, r->AF.word, r->BC.word, r->DE.word, r->HL.word,
+        r->AFx.word, r->BCx.word, r->DEx.word, r->HLx.word
+    };
+    for (uint16_t word : registers) { h = mix(h, word); }
+    h = mix(h, cpu.getIFF1() | cpu.getIFF2() << 1 | cpu.isHalted() << 2 | cpu.getInterruptMode() << 8);
+    h = mix(h, cpu.getTStates());
+
+    m_chain = mix(m_chain, h);
+    m_frames++;
+    return h;
+}
+
+std::vector<uint64_t> StateHash::loadChains(const std::string& filename)
+{
+    std::vector<uint64_t> chains;
+    std::ifstream file(filename);
+    uint64_t frame, hash, chain;
+    while (file >> std::dec >> frame >> std::hex >> hash >> chain)
+    {
+        chains.push_back(chain);
+    }
+    return chains;
+}
+
+size_t StateHash::firstDivergence(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b)
+{
+    // Chains only match while every frame before matched, so they differ on
+    // a suffix and the first differing frame can be bisected
+    size_t low = 0;
+    size_t high = a.size() < b.size() ? a.size() : b.size();
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (a[middle] == b[middle]) { low = middle + 1; }
+        else { high = middle; }
+    }
+    return low;
+}
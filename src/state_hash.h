@@ -0,0 +1,65 @@
+#ifndef STATE_HASH_H
+#define STATE_HASH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Memory.h"
+
+class Z80;
+
+// 64-bit fingerprint of the registers, interrupt and halt state, clock and
+// memory, taken once per frame to catch runs that drift apart. The address
+// space is hashed per 256 byte page and a page is only rehashed once its write
+// counter moved, so bytes changed through memory[] directly need touchAll() as
+// well. Pages of banks that are paged out go by the bank write counters the
+// same way, only the paging itself is hashed every time.
+// The result doesn't depend on the host or on whether SIMD is used.
+class StateHash {
+    public:
+        static const int NUM_PAGES = Spectrum48KMemory::MEM_SIZE >> Spectrum48KMemory::PAGE_SHIFT;
+        static const int PAGE_SIZE = 1 << Spectrum48KMemory::PAGE_SHIFT;
+
+        StateHash();
+
+        // Start a new run, the next update rehashes every page
+        void reset();
+
+        // Hash of the machine now, added to the chain as the next frame
+        uint64_t update(Z80& cpu, const Spectrum48KMemory& m);
+
+        // Hashes of every update so far folded together, two runs with the same
+        // chain at a frame matched on all the frames up to it
+        uint64_t getChain() const { return m_chain; }
+        int getFrames() const { return m_frames; }
+        // Pages rehashed by the last update, of the address space and of banks
+        // paged out
+        int getPagesHashed() const { return m_pagesHashed; }
+
+        // Hash of the PAGE_SIZE bytes at data, SSE2 when the host has it
+        static uint64_t hashPage(const uint8_t* data, int page);
+        // Same result one word at a time, the reference for hashPage
+        static uint64_t hashPageScalar(const uint8_t* data, int page);
+
+        // "frame hash chain" lines in hex, as written by Emulator::setStateHashLog.
+        // Returns the chains, empty if the file can't be read.
+        static std::vector<uint64_t> loadChains(const std::string& filename);
+
+        // First frame where two runs differ by binary search of their chains, the
+        // shorter length if one run is a prefix of the other
+        static size_t firstDivergence(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b);
+
+    private:
+        uint64_t m_pageHashes[NUM_PAGES];
+        uint32_t m_pageWrites[NUM_PAGES];   // Counters the page hashes were taken at
+        bool m_valid;                       // Page hashes match m_pageWrites
+        uint64_t m_bankHashes[Spectrum48KMemory::MAX_BANKS][Spectrum48KMemory::BANK_PAGES];
+        uint32_t m_bankWrites[Spectrum48KMemory::MAX_BANKS][Spectrum48KMemory::BANK_PAGES];
+        bool m_bankValid[Spectrum48KMemory::MAX_BANKS];    // Bank hashes taken since reset
+        uint64_t m_chain;
+        int m_frames;
+        int m_pagesHashed;
+};
+
+#endif
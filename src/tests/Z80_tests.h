@@ -7,10 +7,10 @@
 #include <sstream>
 #include <utility>
 
-#include "../z80.h"
-#include "../memory.h"
+#include "../Z80.h"
+#include "../Memory.h"
 #include "../debugger.h"
-#include "../ula.h"
+#include "../ULA.h"
 #include "../utils.h"
 
 struct Z80TestCase {
@@ -33,12 +33,14 @@ struct Z80TestCase {
 };
 
 template <typename T>
-void assertEqual(T a, T b, Z80TestCase& t, std::string desc);
+bool assertEqual(T a, T b, Z80TestCase& t, std::string desc);
 
 class Z80Tester {
     public:
-        void parseTestFiles(std::string in, std::string expected);
-        void runTests();
+        // False if either file can't be opened
+        bool parseTestFiles(std::string in, std::string expected);
+        // True if every case that isn't skipped matched
+        bool runTests();
     protected:
         // Helper functions filling the input CPU state from input strings
         void parseRegisters(Z80Registers* r, std::vector<std::string>& str);
@@ -48,7 +50,7 @@ class Z80Tester {
         bool fillExpected(Z80TestCase* testCase, std::ifstream& inStream);
 
         // Compare test result with expected values
-        void compareResults(Z80TestCase &test, Z80* z80);
+        bool compareResults(Z80TestCase &test, Z80* z80);
     private:
         std::vector<Z80TestCase> m_testCases;
 };
\ No newline at end of file
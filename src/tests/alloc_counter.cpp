@@ -0,0 +1,48 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+static std::atomic<size_t> s_allocations(0);
+
+size_t allocationCount()
+{
+    return s_allocations.load(std::memory_order_relaxed);
+}
+
+// Replaced in every binary this file is linked into, only the tests are
+
+void* operator new(size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) { size = 1; }
+    void* p = std::malloc(size);
+    if (!p) { throw std::bad_alloc(); }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,11 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <stddef.h>
+
+// Number of calls to the global operator new since the program started.
+// alloc_counter.cpp replaces operator new/delete to count them, link it
+// into test binaries only.
+size_t allocationCount();
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,341 @@
+#include "core_bench.h"
+#include "../debugger.h"
+#include "../ULA.h"
+
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+
+// Copy loop with a subroutine call, mixes loads, stores, ALU, stack and CB opcodes
+static const uint8_t benchmarkProgram[] = {
+    0x31, 0x00, 0x80,       // 0000  LD SP,8000h
+    0x21, 0x00, 0x60,       // 0003  LD HL,6000h
+    0x01, 0x00, 0x08,       // 0006  LD BC,0800h
+    0x7E,                   // 0009  loop: LD A,(HL)
+    0x81,                   // 000A  ADD A,C
+    0xA8,                   // 000B  XOR B
+    0xCB, 0x3F,             // 000C  SRL A
+    0x77,                   // 000E  LD (HL),A
+    0x23,                   // 000F  INC HL
+    0xCD, 0x20, 0x00,       // 0010  CALL 0020h
+    0x0B,                   // 0013  DEC BC
+    0x78,                   // 0014  LD A,B
+    0xB1,                   // 0015  OR C
+    0x20, 0xF1,             // 0016  JR NZ,loop
+    0xC3, 0x03, 0x00,       // 0018  JP 0003h
+    0x00, 0x00, 0x00, 0x00, 0x00,
+    0xE5,                   // 0020  PUSH HL
+    0x2A, 0x00, 0x70,       // 0021  LD HL,(7000h)
+    0x23,                   // 0024  INC HL
+    0x22, 0x00, 0x70,       // 0025  LD (7000h),HL
+    0xEB,                   // 0028  EX DE,HL
+    0xE1,                   // 0029  POP HL
+    0xC9                    // 002A  RET
+};
+
+static void loadProgram(Z80& cpu, Spectrum48KMemory& memory)
+{
+    cpu.init();
+    for (int i = 0; i < Spectrum48KMemory::MEM_SIZE; i++)
+    {
+        memory.memory[i] = 0;
+    }
+    for (int i = 0; i < (int) sizeof(benchmarkProgram); i++)
+    {
+        memory.memory[i] = benchmarkProgram[i];
+    }
+}
+
+void runCoreBenchmark()
+{
+#if defined(Z80_SWITCH_CORE)
+    std::cout << "Running core benchmark (switch core)..." << std::endl;
+#elif defined(Z80_DYNAREC)
+    std::cout << "Running core benchmark (call threaded blocks)..." << std::endl;
+#else
+    std::cout << "Running core benchmark (instruction table core)..." << std::endl;
+#endif
+
+    Spectrum48KMemory memory;
+    ULA ula(nullptr);
+    Debugger debugger;
+    Z80 cpu(&memory, &ula, &debugger);
+
+    const int frames = 500;
+
+    // Count the instructions in the measured frames by single stepping
+    loadProgram(cpu, memory);
+    uint64_t instructions = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        uint64_t frameEnd = (uint64_t) (f + 1) * Z80::FRAME_CYCLES;
+        while (cpu.getTStates() < frameEnd)
+        {
+            cpu.nextInstruction();
+            instructions++;
+        }
+        cpu.simulateFrame();
+    }
+
+    loadProgram(cpu, memory);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; f++)
+    {
+        cpu.simulateFrame();
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    std::cout << instructions << " instructions in " << frames << " frames, "
+        << seconds * 1000.0 << " ms" << std::endl;
+    std::cout << "MIPS: " << instructions / seconds / 1000000.0 << std::endl;
+    std::cout << "Speed: " << (frames / 50.0) / seconds << "x real time" << std::endl;
+#ifdef Z80_DYNAREC
+    const Dynarec::Stats& stats = cpu.getDynarecStats();
+    std::cout << "Translated blocks: " << stats.translations << ", native instructions: "
+        << stats.instructions << std::endl;
+#endif
+}
+
+static bool loadROM(Z80& cpu, Spectrum48KMemory& memory, const std::string& romFile)
+{
+    std::ifstream file(romFile, std::ios::binary);
+    if (!file) { return false; }
+
+    cpu.init();
+    for (int i = 0; i < Spectrum48KMemory::MEM_SIZE; i++)
+    {
+        memory.memory[i] = 0;
+    }
+    file.read(reinterpret_cast<char*>(memory.ROM), Spectrum48KMemory::ROM_size);
+    return file.gcount() == Spectrum48KMemory::ROM_size;
+}
+
+// Run frames the way Emulator::loop does, returns the time taken in seconds
+static double runFrames(Z80& cpu, int frames)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; f++)
+    {
+        cpu.nmi();
+        cpu.simulateFrame();
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(stop - start).count();
+}
+
+void runBlockCacheBenchmark(const std::string& romFile)
+{
+    Spectrum48KMemory memory;
+    ULA ula(nullptr);
+    Debugger debugger;
+    Z80 cpu(&memory, &ula, &debugger);
+
+    const int frames = 500;
+    bool rom = loadROM(cpu, memory, romFile);
+    std::cout << "Running block cache benchmark ("
+        << (rom ? "ROM boot" : "built in program, no ROM at " + romFile) << ")..." << std::endl;
+
+    cpu.setBlockCacheEnabled(false);
+    if (!rom) { loadProgram(cpu, memory); }
+    double tableSeconds = runFrames(cpu, frames);
+
+    cpu.setBlockCacheEnabled(true);
+    if (rom) { loadROM(cpu, memory, romFile); }
+    else { loadProgram(cpu, memory); }
+    const BlockCache::Stats start = cpu.getBlockCacheStats();
+    double blockSeconds = runFrames(cpu, frames);
+    const BlockCache::Stats& stats = cpu.getBlockCacheStats();
+
+    uint64_t hits = stats.hits - start.hits;
+    uint64_t lookups = hits + stats.misses - start.misses;
+    uint64_t instructions = stats.instructions - start.instructions;
+    std::cout << "Block lookups: " << lookups << ", hit rate " << 100.0 * hits / lookups << "%, "
+        << (double) instructions / lookups << " instructions per block" << std::endl;
+    std::cout << "Instruction table: " << tableSeconds * 1000.0 << " ms, block cache: "
+        << blockSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "Speedup: " << tableSeconds / blockSeconds << "x" << std::endl;
+}
+
+// Counts of the n-grams (2 to 4 instructions) executed without a jump in
+// between, returns the number of instructions run
+static uint64_t profileNGrams(Z80& cpu, Spectrum48KMemory& memory, int frames,
+    std::unordered_map<uint64_t, uint64_t>& counts)
+{
+    Z80Decoder decoder;
+    decoder.loadInstructionSet(z80InstructionTable().hot);
+    cpu.setBlockCacheEnabled(false);
+
+    uint64_t history = 0;       // Indices of the last instructions, 12 bits each
+    int length = 0;
+    uint64_t instructions = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        cpu.nmi();
+        uint64_t frameEnd = cpu.getTStates() - cpu.getCyclesSinceLastFrame() + Z80::FRAME_CYCLES;
+        while (cpu.getTStates() < frameEnd)
+        {
+            uint16_t pc = cpu.getRegisters()->PC;
+            DecodedOpcode op = decoder.decode(memory, pc);
+            cpu.nextInstruction();
+            instructions++;
+
+            history = (history << 12) | op.index;
+            length = std::min(length + 1, 4);
+            for (int n = 2; n <= length; n++)
+            {
+                uint64_t key = (history & ((1ULL << (12 * n)) - 1)) | ((uint64_t) n << 48);
+                counts[key]++;
+            }
+            if (cpu.getRegisters()->PC != (uint16_t) (pc + op.length + op.numDataBytes)) { length = 0; }
+        }
+        cpu.simulateFrame();
+    }
+    cpu.setBlockCacheEnabled(true);
+    return instructions;
+}
+
+void runSuperinstructionBenchmark(const std::string& romFile)
+{
+    Spectrum48KMemory memory;
+    ULA ula(nullptr);
+    Debugger debugger;
+    Z80 cpu(&memory, &ula, &debugger);
+    const int frames = 500;
+
+    bool rom = loadROM(cpu, memory, romFile);
+    std::cout << "Running superinstruction benchmark (built in program"
+        << (rom ? " and ROM boot" : ", no ROM at " + romFile) << ")..." << std::endl;
+
+    std::unordered_map<uint64_t, uint64_t> counts;
+    loadProgram(cpu, memory);
+    uint64_t profiled = profileNGrams(cpu, memory, 50, counts);
+    if (rom)
+    {
+        loadROM(cpu, memory, romFile);
+        profiled += profileNGrams(cpu, memory, 50, counts);
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> ngrams(counts.begin(), counts.end());
+    std::sort(ngrams.begin(), ngrams.end(),
+        [](const std::pair<uint64_t, uint64_t>& a, const std::pair<uint64_t, uint64_t>& b) { return a.second > b.second; });
+    const InstructionTable& table = z80InstructionTable();
+    std::cout << "Most frequent n-grams:" << std::endl;
+    for (size_t i = 0; i < ngrams.size() && i < 10; i++)
+    {
+        int n = (int) (ngrams[i].first >> 48);
+        std::cout << "  " << ngrams[i].second << "  ";
+        for (int j = n - 1; j >= 0; j--)
+        {
+            std::cout << table.cold[(ngrams[i].first >> (12 * j)) & 0xFFF].mnemonic << (j ? "; " : "");
+        }
+        std::cout << std::endl;
+    }
+
+    // Where the block cache's table stands in that profile
+    BlockCache cache;
+    cache.loadInstructionSet(table.hot.data(), nullptr);
+    std::cout << "Superinstructions:" << std::endl;
+    for (int id = 1; id <= cache.getSuperinstructionCount(); id++)
+    {
+        const Superinstruction& super = cache.superinstruction((uint8_t) id);
+        uint64_t key = (uint64_t) super.count << 48;
+        for (int j = 0; j < super.count; j++) { key |= (uint64_t) super.opcodes[j] << (12 * (super.count - 1 - j)); }
+        auto found = counts.find(key);
+        uint64_t runs = found == counts.end() ? 0 : found->second;
+        size_t rank = 1;
+        for (const std::pair<uint64_t, uint64_t>& ngram : ngrams)
+        {
+            rank += (ngram.first >> 48) == (uint64_t) super.count && ngram.second > runs;
+        }
+        std::cout << "  " << runs << "  ";
+        for (int j = 0; j < super.count; j++) { std::cout << table.cold[super.opcodes[j]].mnemonic << (j + 1 < super.count ? "; " : ""); }
+        std::cout << "  (" << (runs ? std::to_string(rank) : std::string("-")) << " of the " << (int) super.count << "-grams, "
+            << (profiled ? 100.0 * runs * super.count / profiled : 0.0) << "% of the instructions)" << std::endl;
+    }
+
+    for (int workload = 0; workload < (rom ? 2 : 1); workload++)
+    {
+        double seconds[2];
+        uint64_t dispatches[2], instructions = 0;
+        for (int fused = 0; fused < 2; fused++)
+        {
+            cpu.setSuperinstructionsEnabled(fused);
+            if (workload == 0) { loadProgram(cpu, memory); } else { loadROM(cpu, memory, romFile); }
+            const BlockCache::Stats start = cpu.getBlockCacheStats();
+            seconds[fused] = runFrames(cpu, frames);
+            const BlockCache::Stats& stats = cpu.getBlockCacheStats();
+            instructions = stats.instructions - start.instructions;
+            dispatches[fused] = instructions - (stats.fused - start.fused) +
+                (stats.superinstructions - start.superinstructions);
+        }
+        std::cout << (workload == 0 ? "Built in program: " : "ROM boot: ") << instructions
+            << " instructions, dispatches " << dispatches[0] << " -> " << dispatches[1] << " ("
+            << 100.0 * (dispatches[0] - dispatches[1]) / dispatches[0] << "% fewer), "
+            << seconds[0] * 1000.0 << " ms -> " << seconds[1] * 1000.0 << " ms, speedup "
+            << seconds[0] / seconds[1] << "x" << std::endl;
+    }
+}
+
+void runMemoryWriteBenchmark()
+{
+    std::cout << "Running 48K memory write benchmark..." << std::endl;
+
+    std::unique_ptr<Spectrum48KMemory> memory(new Spectrum48KMemory());
+    const int writes = 1 << 26;
+    double best = 0;
+    uint32_t sum = 0;
+
+    // Best of a few rounds, the first one also warms the caches up
+    for (int round = 0; round < 5; round++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        uint16_t address = 0x4000;
+        for (int i = 0; i < writes; i++)
+        {
+            memory->write(address, (uint8_t) i);
+            address = (uint16_t) (address + 0x0401) | 0x4000;
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (round == 0 || seconds < best) { best = seconds; }
+    }
+    for (int i = 0; i < Spectrum48KMemory::MEM_SIZE; i++) { sum += memory->memory[i]; }
+
+    std::cout << writes << " writes, " << best * 1000000000.0 / writes << " ns each (checksum "
+        << sum << ")" << std::endl;
+}
+
+void runStartupBenchmark()
+{
+    std::cout << "Running startup benchmark..." << std::endl;
+
+    Spectrum48KMemory memory;
+    ULA ula(nullptr);
+    Debugger debugger;
+    const int instances = 200;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::unique_ptr<Z80> first(new Z80(&memory, &ula, &debugger));
+    auto stop = std::chrono::high_resolution_clock::now();
+    double firstSeconds = std::chrono::duration<double>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < instances; i++)
+    {
+        Z80 cpu(&memory, &ula, &debugger);
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    double constructSeconds = std::chrono::duration<double>(stop - start).count() / instances;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < instances; i++)
+    {
+        first->init();
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    double initSeconds = std::chrono::duration<double>(stop - start).count() / instances;
+
+    std::cout << "First instance: " << firstSeconds * 1000000.0 << " us, each further instance: "
+        << constructSeconds * 1000000.0 << " us, init(): " << initSeconds * 1000000.0 << " us" << std::endl;
+}
@@ -0,0 +1,32 @@
+#ifndef CORE_BENCH_H
+#define CORE_BENCH_H
+
+#include "../Z80.h"
+#include "../Memory.h"
+#include <iostream>
+#include <chrono>
+#include <string>
+
+// Measures emulated MIPS of the CPU core selected at build time
+// (instruction table by default, -D Z80_SWITCH_CORE for the switch core,
+// -D Z80_DYNAREC for call threaded blocks)
+void runCoreBenchmark();
+
+// Block cache hit rate and speedup over the instruction table path. Boots
+// romFile when it can be loaded, otherwise runs the built in program.
+void runBlockCacheBenchmark(const std::string& romFile);
+
+// Profiles the most frequent straight line opcode n-grams of the built in
+// program and of a ROM boot (when romFile loads), shows where each of the
+// block cache superinstructions ranks in that profile, then compares
+// dispatches and time with and without them
+void runSuperinstructionBenchmark(const std::string& romFile);
+
+// Time per Spectrum48KMemory::write() on the 48K, spread over the whole RAM
+// screen included
+void runMemoryWriteBenchmark();
+
+// Time to build the first Z80, to build further ones and to init() one again
+void runStartupBenchmark();
+
+#endif // CORE_BENCH_H
@@ -0,0 +1,154 @@
+#include "decoder_bench.h"
+
+#include <set>
+#include <random>
+
+static const std::set<uint8_t> prefixes = { 0xDD, 0xFD, 0xED, 0xCB };
+
+// Previous implementation of Z80::parseNextInstruction, kept as the reference.
+// Returns the instruction index and sets numBytes the same way nextInstruction did.
+static int legacyParse(Spectrum48KMemory& m, uint16_t location, int& numBytes)
+{
+    std::vector<uint8_t> bytes;
+
+    int i = 0;
+    while (prefixes.find(m[location]) != prefixes.end())
+    {
+        bytes.push_back(m[location]);
+        location++;
+        if (bytes.size() >= 2 && i > 0 &&
+              ( (bytes[i-1] == 0xFD && bytes[i] == 0xDD) ||
+                (bytes[i-1] == 0xDD && bytes[i] == 0xFD)
+              )
+           )
+        {
+            bytes.erase(bytes.begin() + i - 1);
+        }
+        i++;
+        if (bytes.size() == 2 && ( (bytes[0] == 0xDD || bytes[0] == 0xFD) && bytes[1] == 0xCB ))
+        {
+            break;
+        }
+    }
+
+    if (bytes.size() == 2 && ( (bytes[0] == 0xDD || bytes[0] == 0xFD) && bytes[1] == 0xCB ))
+    {
+        location++;
+    }
+
+    if ( !(bytes.size() == 2 && (bytes[0] == 0xCB && bytes[1] == 0xCB)) )
+    if ( !(bytes.size() == 2 && (bytes[0] == 0xCB && bytes[1] == 0xED)) )
+    if ( !(bytes.size() == 2 && (bytes[0] == 0xCB && bytes[1] == 0xDD)) )
+    if ( !(bytes.size() == 2 && (bytes[0] == 0xCB && bytes[1] == 0xFD)) )
+    {
+        bytes.push_back(m[location]);
+        if ( bytes.size() > 1 && bytes[1] == 0xED ) { bytes[0] = 0; }
+    }
+
+    if (bytes.size() > 3) { return -1; }
+
+    while (bytes.size() < 3) { bytes.insert(bytes.begin(), 0); }
+
+    int pref1 = 0;
+    switch (bytes[0])
+    {
+        case 0xDD: pref1 = 1; break;
+        case 0xFD: pref1 = 2; break;
+        case 0xED: pref1 = 3; break;
+        case 0xCB: pref1 = 4; break;
+        default: pref1 = 0; break;
+    }
+    int pref2 = 0;
+    switch (bytes[1])
+    {
+        case 0xDD: pref2 = 1; break;
+        case 0xFD: pref2 = 2; break;
+        case 0xED: pref2 = 3; break;
+        case 0xCB: pref2 = 4; break;
+        default: pref2 = 0; break;
+    }
+
+    int instruction = ((pref1 > 0) ? pref1 + 4 : 0) * 256 + pref2 * 256 + bytes[2];
+    numBytes = ( instruction >= 5*256 ) ? 3 : ( instruction >= 256 ) ? 2 : 1;
+    return instruction;
+}
+
+// The prefix walk only handled a single prefix (or DDCB/FDCB), chains of
+// prefixes produced indices outside the instruction set
+static bool isSinglePrefixed(Spectrum48KMemory& m, uint16_t pc)
+{
+    uint8_t b0 = m[pc];
+    uint8_t b1 = m[(uint16_t)(pc + 1)];
+    uint8_t b2 = m[(uint16_t)(pc + 2)];
+    if (prefixes.find(b0) == prefixes.end()) { return true; }
+    if (b0 == 0xCB) { return prefixes.find(b1) == prefixes.end() || prefixes.find(b2) == prefixes.end(); }
+    if (b0 == 0xED) { return prefixes.find(b1) == prefixes.end(); }
+    return b1 == 0xCB || prefixes.find(b1) == prefixes.end();
+}
+
+void runDecoderBenchmark()
+{
+    std::cout << "Running decoder benchmark..." << std::endl;
+
+    Spectrum48KMemory memory;
+    std::mt19937 rng(0x5A5A);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (int i = 0; i < Spectrum48KMemory::MEM_SIZE; i++)
+    {
+        memory.memory[i] = (uint8_t) byte(rng);
+    }
+
+    Z80Decoder decoder;
+    decoder.loadInstructionSet(z80InstructionTable().hot);
+
+    // Both decoders must agree on every well formed opcode
+    const uint16_t end = Spectrum48KMemory::MEM_SIZE - 4;
+    int mismatches = 0;
+    int checked = 0;
+    for (uint16_t pc = 0; pc < end; pc++)
+    {
+        if (!isSinglePrefixed(memory, pc)) { continue; }
+        int numBytes = 0;
+        int expected = legacyParse(memory, pc, numBytes);
+        DecodedOpcode op = decoder.decode(memory, pc);
+        checked++;
+        if (op.index != expected || op.length != numBytes)
+        {
+            mismatches++;
+            std::cerr << "Decoder mismatch at " << std::hex << pc << ": " << op.index
+                << " should be " << expected << std::dec << std::endl;
+        }
+    }
+    std::cout << "Decoder checked " << checked << " opcodes, " << mismatches << " mismatches" << std::endl;
+
+    const int passes = 20;
+    uint64_t sum = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int p = 0; p < passes; p++)
+    {
+        for (uint16_t pc = 0; pc < end; pc++)
+        {
+            int numBytes = 0;
+            sum += legacyParse(memory, pc, numBytes) + numBytes;
+        }
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    for (int p = 0; p < passes; p++)
+    {
+        for (uint16_t pc = 0; pc < end; pc++)
+        {
+            DecodedOpcode op = decoder.decode(memory, pc);
+            sum += op.index + op.length;
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    double decodes = (double) passes * end;
+    double legacyNs = std::chrono::duration<double, std::nano>(mid - start).count() / decodes;
+    double tableNs = std::chrono::duration<double, std::nano>(stop - mid).count() / decodes;
+
+    std::cout << "Prefix walk:  " << legacyNs << " ns/decode" << std::endl;
+    std::cout << "Decode table: " << tableNs << " ns/decode" << std::endl;
+    std::cout << "Speedup: " << legacyNs / tableNs << "x (checksum " << sum << ")" << std::endl;
+}
@@ -0,0 +1,14 @@
+#ifndef DECODER_BENCH_H
+#define DECODER_BENCH_H
+
+#include "../decoder.h"
+#include "../instructions.h"
+#include "../Memory.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+// Compares Z80Decoder against the previous prefix walk and measures decode throughput
+void runDecoderBenchmark();
+
+#endif // DECODER_BENCH_H
@@ -1,4 +1,14 @@
 #include "instruction_test.h"
+#include "alloc_counter.h"
+#include "../debugger.h"
+#include "../ULA.h"
+#include "../state_hash.h"
+#include "../spectrum128k.h"
+#include "../contention.h"
+#include "../utils.h"
+
+#include <algorithm>
+#include <random>
 
 // Define a global vector to hold all our test cases
 std::vector<TestCase> allTests;
@@ -8,6 +18,42 @@ void addTestCase(const TestCase& testCase) {
     allTests.push_back(testCase);
 }
 
+// Put the runner's CPU and memory back to power on, with every byte zero
+static void resetFixture(Z80& cpu, Spectrum48KMemory& mem)
+{
+    cpu.init();
+    cpu.setInterruptMode(0);
+    memset(mem.memory, 0, Spectrum48KMemory::MEM_SIZE);
+    mem.touchAll();
+}
+
+// Copy of the memory and CPU state the setup left in the runner's fixture, on
+// a machine of its own. With singleStep its debugger holds a breakpoint that
+// never hits, so it runs one instruction at a time where the fixture takes
+// the shortcuts being tested.
+struct FixtureCopy {
+    std::unique_ptr<Spectrum48KMemory> memory;
+    ULA ula;
+    Debugger debugger;
+    Z80 cpu;
+
+    FixtureCopy(Z80& fixture, const Spectrum48KMemory& fixtureMemory, bool singleStep)
+        : memory(new Spectrum48KMemory()), ula(nullptr), cpu(memory.get(), &ula, &debugger)
+    {
+        if (singleStep) { debugger.addBreakpoint(Breakpoint(0xFFFF)); }
+        memcpy(memory->memory, fixtureMemory.memory, Spectrum48KMemory::MEM_SIZE);
+        memory->touchAll();
+        cpu.loadState(fixture.saveState());
+    }
+
+    // Same registers and memory as the fixture
+    bool matches(Z80& fixture, const Spectrum48KMemory& fixtureMemory)
+    {
+        return memcmp(cpu.getRegisters(), fixture.getRegisters(), sizeof(Z80Registers)) == 0 &&
+            memcmp(memory->memory, fixtureMemory.memory, Spectrum48KMemory::MEM_SIZE) == 0;
+    }
+};
+
 // Function to initialize and add test cases
 void initializeTests() {
     // Example test: NOP Instruction
@@ -16,7 +62,7 @@ void initializeTests() {
         [](Z80& cpu, Spectrum48KMemory& mem) { 
             // Setup: Ensure PC starts at 0
             cpu.getRegisters()->PC = 0;
-            mem[0] = 0x00; // NOP instruction
+            mem.poke(0, 0x00); // NOP instruction
             std::cout << "Test setup complete: NOP instruction at PC=0." << std::endl;
         },
         [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
@@ -30,17 +76,839 @@ void initializeTests() {
         }
     });
 
+    // Executing instructions must not touch the heap
+    addTestCase({
+        "simulateFrame allocations",
+        [](Z80& cpu, Spectrum48KMemory& mem) {
+            // LD HL,8000h; loop: LD (HL),A; INC HL; ADD A,7; LD (IX+1),A; JP loop
+            const uint8_t program[] = { 0x21, 0x00, 0x80, 0x77, 0x23, 0xC6, 0x07,
+                                        0xDD, 0x77, 0x01, 0xC3, 0x03, 0x00 };
+            for (int i = 0; i < (int) sizeof(program); i++) { mem.poke(i, program[i]); }
+            cpu.getRegisters()->PC = 0;
+            cpu.getRegisters()->IX.word = 0x9000;
+        },
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            cpu.simulateFrame();
+            size_t before = allocationCount();
+            cpu.simulateFrame();
+            size_t allocations = allocationCount() - before;
+            std::cout << "Allocations per frame: " << allocations << std::endl;
+
+            // The counter has to be live, or the check above proves nothing
+            before = allocationCount();
+            void* probe = ::operator new(1);    // A new expression may be optimised out
+            bool counting = allocationCount() == before + 1;
+            ::operator delete(probe);
+            return allocations == 0 && counting;
+        }
+    });
+
+    // The flag tables must reproduce the bit by bit helpers for every operand
+    // pair, carry in and F the operation starts from
+    addTestCase({
+        "Flag tables match the ALU helpers",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            const uint8_t bases[] = { 0x00, 0xFF, 0x28, 0xD7 };
+            int mismatches = 0;
+            for (uint8_t base : bases)
+            {
+                for (int carry = 0; carry < 2; carry++)
+                {
+                    for (int ab = 0; ab < 0x10000; ab++)
+                    {
+                        uint8_t a = ab >> 8, b = ab & 0xFF;
+                        Z80Registers helper, table;
+                        auto reset = [&]() {
+                            helper.AF.bytes.low.byte = table.AF.bytes.low.byte = (base & 0xFE) | carry;
+                        };
+                        auto compare = [&](uint8_t expected, uint8_t result) {
+                            mismatches += expected != result || helper.AF.bytes.low.byte != table.AF.bytes.low.byte;
+                        };
+
+                        reset();
+                        uint8_t expected = add<uint8_t>(a, b, &helper, ADD8, true);
+                        helper.AF.bytes.low.NF = 0;
+                        compare(expected, adc8(a, b, &table));
+
+                        reset();
+                        expected = add<uint8_t>(a, -b, &helper, SUB8, false, true);
+                        helper.AF.bytes.low.NF = 1;
+                        compare(expected, sbc8(a, -b, &table));
+
+                        if (carry) { continue; }
+
+                        reset();
+                        expected = add<uint8_t>(a, b, &helper, ADD8);
+                        helper.AF.bytes.low.NF = 0;
+                        compare(expected, add8(a, b, &table));
+
+                        reset();
+                        expected = add<uint8_t>(a, -b, &helper, SUB8);
+                        helper.AF.bytes.low.NF = 1;
+                        compare(expected, sub8(a, -b, &table));
+
+                        reset();
+                        compare(bitwiseAnd<uint8_t>(a, b, &helper), and8(a, b, &table));
+                        reset();
+                        compare(bitwiseXor<uint8_t>(a, b, &helper), xor8(a, b, &table));
+                        reset();
+                        compare(bitwiseOr<uint8_t>(a, b, &helper), or8(a, b, &table));
+                    }
+                }
+
+                for (int value = 0; value < 256; value++)
+                {
+                    uint8_t a = value;
+                    Z80Registers helper, table;
+                    helper.AF.bytes.low.byte = table.AF.bytes.low.byte = base;
+                    helper.AF.bytes.low.PF = a == 0x7F;
+                    uint8_t expected = add<uint8_t>(a, 1, &helper, INC8);
+                    helper.AF.bytes.low.NF = false;
+                    mismatches += expected != inc8(a, &table) || helper.AF.bytes.low.byte != table.AF.bytes.low.byte;
+
+                    helper.AF.bytes.low.byte = table.AF.bytes.low.byte = base;
+                    helper.AF.bytes.low.PF = a == 0x80;
+                    expected = add<uint8_t>(a, -1, &helper, DEC8);
+                    helper.AF.bytes.low.NF = true;
+                    mismatches += expected != dec8(a, &table) || helper.AF.bytes.low.byte != table.AF.bytes.low.byte;
+
+                    // DAA as it was computed before the tables
+                    for (int flags = 0; flags < 8; flags++)
+                    {
+                        bool C = flags & 1, H = flags & 2, N = flags & 4;
+                        uint8_t A = a;
+                        if ((A & 0xF) > 9 || H) { A = N ? A - 0x06 : A + 0x06; }
+                        if (a > 0x99 || C) { A = N ? A - 0x60 : A + 0x60; }
+
+                        helper.AF.bytes.high = A;
+                        helper.AF.bytes.low.byte = base;
+                        helper.AF.bytes.low.CF = daaCarry(C, a);
+                        helper.AF.bytes.low.HF = daaHalfCarry(N, H, a);
+                        helper.AF.bytes.low.NF = N;
+                        helper.AF.bytes.low.SF = A >> 7;
+                        setUndocumentedFlags(A, &helper);
+                        helper.AF.bytes.low.ZF = A == 0;
+                        helper.AF.bytes.low.PF = hasEvenParity(A);
+
+                        table.AF.bytes.high = a;
+                        table.AF.bytes.low.byte = base;
+                        table.AF.bytes.low.CF = C;
+                        table.AF.bytes.low.HF = H;
+                        table.AF.bytes.low.NF = N;
+                        daa(&table);
+                        mismatches += helper.AF.word != table.AF.word;
+                    }
+                }
+            }
+            std::cout << "Flag table mismatches: " << mismatches << std::endl;
+            return mismatches == 0;
+        }
+    });
+
+    // Block instructions repeated in bulk must end each frame in the same state
+    // as single steps, a breakpoint that never hits forces the single steps
+    addTestCase({
+        "Repeated block instructions match single steps",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            struct Case { uint8_t opcode; uint16_t hl, de, bc; uint8_t a; };
+            const Case cases[] = {
+                { 0xB0, 0x7000, 0x7400, 0x0800, 0x00 },     // LDIR
+                { 0xB0, 0x7000, 0x7001, 0x1000, 0x00 },     // LDIR fill, spans frames
+                { 0xB0, 0x7000, 0x7003, 0x0300, 0x00 },     // LDIR repeating a pattern
+                { 0xB0, 0x7000, 0x5FF0, 0x0100, 0x00 },     // LDIR over its own opcode
+                { 0xB0, 0xFFF0, 0xBFF8, 0x0040, 0x00 },     // LDIR past the end of memory
+                { 0xB0, 0x7000, 0x7100, 0x0000, 0x00 },     // LDIR with BC = 0
+                { 0xB8, 0x7FFF, 0x8FFF, 0x0900, 0x00 },     // LDDR
+                { 0xB8, 0x7001, 0x7000, 0x0800, 0x00 },     // LDDR fill
+                { 0xB1, 0x7000, 0x0000, 0x2000, 0x55 },     // CPIR
+                { 0xB1, 0xBF00, 0x0000, 0x0200, 0x55 },     // CPIR past the end of memory
+                { 0xB9, 0x7FFF, 0x0000, 0x2000, 0x55 },     // CPDR
+                { 0xB2, 0x7000, 0x0000, 0x00FE, 0x00 },     // INIR
+                { 0xBA, 0x7000, 0x0000, 0x0000, 0x00 },     // INDR
+                { 0xB3, 0x7000, 0x0000, 0x0010, 0x00 },     // OTIR
+                { 0xBB, 0x7000, 0x0000, 0x0010, 0x00 },     // OTDR
+            };
+
+            int mismatches = 0;
+            for (const Case& c : cases)
+            {
+                // Sparse non zero bytes, so CPIR has matches to stop on
+                resetFixture(cpu, mem);
+                std::mt19937 rng(c.opcode);
+                for (int i = 0; i < Spectrum48KMemory::MEM_SIZE; i++) { mem.memory[i] = rng() % 8 == 0 ? 0x55 : 0x00; }
+                // LD HL,nn; LD DE,nn; LD BC,nn; LD A,n; block instruction; JR -2
+                const uint8_t program[] = {
+                    0x21, (uint8_t) c.hl, (uint8_t) (c.hl >> 8),
+                    0x11, (uint8_t) c.de, (uint8_t) (c.de >> 8),
+                    0x01, (uint8_t) c.bc, (uint8_t) (c.bc >> 8),
+                    0x3E, c.a, 0xED, c.opcode, 0x18, 0xFE
+                };
+                for (int i = 0; i < (int) sizeof(program); i++) { mem[0x6000 + i] = program[i]; }
+                cpu.getRegisters()->PC = 0x6000;
+
+                // Bulk runs must count the same writes in each page as well
+                FixtureCopy stepped(cpu, mem, true);
+                uint32_t pageWrites[2][Spectrum48KMemory::NUM_PAGES];
+                memcpy(pageWrites[0], mem.pageWrites, sizeof(mem.pageWrites));
+                memcpy(pageWrites[1], stepped.memory->pageWrites, sizeof(mem.pageWrites));
+                for (int frame = 0; frame < 3; frame++)
+                {
+                    cpu.simulateFrame();
+                    stepped.cpu.simulateFrame();
+                }
+                bool same = stepped.matches(cpu, mem);
+                for (int p = 0; p < Spectrum48KMemory::NUM_PAGES; p++)
+                {
+                    same &= mem.pageWrites[p] - pageWrites[0][p] == stepped.memory->pageWrites[p] - pageWrites[1][p];
+                }
+                if (!same)
+                {
+                    std::cout << "ED " << std::hex << +c.opcode << " from " << c.hl << std::dec << " differs" << std::endl;
+                    mismatches++;
+                }
+            }
+            return mismatches == 0;
+        }
+    });
+
+    // Skipping to the interrupt while halted must end each frame in the same
+    // state as stepping through the HALTs, and the interrupt must return past
+    // the HALT
+    addTestCase({
+        "HALT fast forward matches single steps",
+        [](Z80& cpu, Spectrum48KMemory& mem) {
+            resetFixture(cpu, mem);
+            // IM 1; EI; loop: LD B,200; wait: DJNZ wait; HALT; INC E; JR loop
+            const uint8_t program[] = { 0xED, 0x56, 0xFB, 0x06, 0xC8, 0x10, 0xFE, 0x76, 0x1C, 0x18, 0xF8 };
+            for (int i = 0; i < (int) sizeof(program); i++) { mem[0x6000 + i] = program[i]; }
+            // Interrupt handler counts frames at 7000h: LD HL,7000h; INC (HL); EI; RET
+            const uint8_t handler[] = { 0x21, 0x00, 0x70, 0x34, 0xFB, 0xC9 };
+            for (int i = 0; i < (int) sizeof(handler); i++) { mem.poke(0x38 + i, handler[i]); }
+            cpu.getRegisters()->PC = 0x6000;
+            cpu.getRegisters()->SP = 0x8000;
+            cpu.getRegisters()->DE.word = 0;
+        },
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            FixtureCopy stepped(cpu, mem, true);
+            for (Z80* z : { &cpu, &stepped.cpu })
+            {
+                for (int frame = 0; frame < 4; frame++)
+                {
+                    z->nmi();
+                    z->simulateFrame();
+                }
+            }
+
+            std::cout << "T-states fast forwarded in the last frame: " << cpu.getFastForwardedCycles() << std::endl;
+            return stepped.matches(cpu, mem) && cpu.getRegisters()->DE.bytes.low == 3 &&
+                cpu.getFastForwardedCycles() > 0 && stepped.cpu.getFastForwardedCycles() == 0;
+        }
+    });
+
+    // A loop polling memory and a port until the interrupt changes the memory
+    // must skip to the end of the frame and still count every frame. The block
+    // cache finds idle loops, the switch core has none.
+#ifndef Z80_SWITCH_CORE
+    addTestCase({
+        "Idle loop skipping matches single steps",
+        [](Z80& cpu, Spectrum48KMemory& mem) {
+            resetFixture(cpu, mem);
+            // IM 1; EI; loop: LD A,(7000h); LD B,A;
+            // wait: IN A,(FEh); LD A,(7000h); CP B; JR Z,wait; INC C; JR loop
+            const uint8_t program[] = {
+                0xED, 0x56, 0xFB, 0x3A, 0x00, 0x70, 0x47,
+                0xDB, 0xFE, 0x3A, 0x00, 0x70, 0xB8, 0x28, 0xF8, 0x0C, 0x18, 0xF1
+            };
+            for (int i = 0; i < (int) sizeof(program); i++) { mem[0x6000 + i] = program[i]; }
+            // Interrupt handler counts frames at 7000h: LD HL,7000h; INC (HL); EI; RET
+            const uint8_t handler[] = { 0x21, 0x00, 0x70, 0x34, 0xFB, 0xC9 };
+            for (int i = 0; i < (int) sizeof(handler); i++) { mem.poke(0x38 + i, handler[i]); }
+            cpu.getRegisters()->PC = 0x6000;
+            cpu.getRegisters()->SP = 0x8000;
+        },
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            FixtureCopy stepped(cpu, mem, true);
+            for (Z80* z : { &cpu, &stepped.cpu })
+            {
+                for (int frame = 0; frame < 4; frame++)
+                {
+                    z->nmi();
+                    z->simulateFrame();
+                }
+            }
+
+            std::cout << "T-states skipped in idle loops in the last frame: " << cpu.getIdleSkippedCycles() << std::endl;
+            return stepped.matches(cpu, mem) && cpu.getRegisters()->BC.bytes.high == 3 &&
+                cpu.getIdleSkippedCycles() > 0 && stepped.cpu.getIdleSkippedCycles() == 0;
+        }
+    });
+#endif
+
+    // Stepping the clock in odd sized slices must stop on the same instruction
+    // as whole frames, with the overshoot carried instead of dropped
+    addTestCase({
+        "runUntil slices match whole frames",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            ULA ula(nullptr);
+            std::unique_ptr<Spectrum48KMemory> memories[2] = {
+                std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory()),
+                std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory())
+            };
+            Debugger debugger;
+            const uint64_t end = 3 * Z80::FRAME_CYCLES;
+
+            Z80Registers result[2];
+            uint64_t tstates[2];
+            int frameCycles = 0;
+            for (int j = 0; j < 2; j++)
+            {
+                Spectrum48KMemory& m = *memories[j];
+                // loop: LD (HL),A; INC HL; ADD A,(HL); EX (SP),HL; JR loop
+                const uint8_t program[] = { 0x77, 0x23, 0x86, 0xE3, 0x18, 0xFA };
+                for (int i = 0; i < (int) sizeof(program); i++) { m[0x6000 + i] = program[i]; }
+
+                Z80 z(&m, &ula, &debugger);
+                z.getRegisters()->PC = 0x6000;
+                z.getRegisters()->SP = 0x5000;
+                z.getRegisters()->HL.word = 0x7000;
+                if (j == 0)
+                {
+                    for (int frame = 0; frame < 3; frame++) { z.simulateFrame(); }
+                    frameCycles = z.getCyclesSinceLastFrame();
+                }
+                else
+                {
+                    for (uint64_t t = 0; t < end; t += 1237) { z.runUntil(t); }
+                    z.runUntil(end);
+                }
+                result[j] = *z.getRegisters();
+                tstates[j] = z.getTStates();
+            }
+
+            std::cout << "T-states carried into the next frame: " << frameCycles << std::endl;
+            return result[0].PC == result[1].PC && result[0].AF.word == result[1].AF.word &&
+                result[0].HL.word == result[1].HL.word && tstates[0] == tstates[1] &&
+                frameCycles > 0 && frameCycles == (int) (tstates[0] - end) &&
+                memcmp(memories[0]->memory, memories[1]->memory, Spectrum48KMemory::MEM_SIZE) == 0;
+        }
+    });
+
+    // The fast policy ignores breakpoints, switching back to the debug policy
+    // waits for the next frame
+    addTestCase({
+        "Debug policy switches at frame boundaries",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            ULA ula(nullptr);
+            std::unique_ptr<Spectrum48KMemory> m(new Spectrum48KMemory());
+            // loop: INC A; JR loop
+            (*m)[0x6000] = 0x3C; (*m)[0x6001] = 0x18; (*m)[0x6002] = 0xFD;
+            Debugger debugger;
+            Breakpoint breakpoint(0x6000);
+            *breakpoint.getEnabled() = true;
+            debugger.addBreakpoint(breakpoint);
+
+            Z80 z(m.get(), &ula, &debugger);
+            z.getRegisters()->PC = 0x6000;
+            z.setDebugging(false);
+            z.simulateFrame();
+            bool fastIgnored = !z.isDebugging() && !debugger.shouldBreak();
+
+            z.setDebugging(true);
+            z.runUntil(z.getTStates() + 1000);
+            bool waitedForFrame = !debugger.shouldBreak();
+
+            z.simulateFrame();
+            bool traced = z.isDebugging() && debugger.shouldBreak() && !debugger.getTrace()->empty();
+
+            Z80 headless(m.get(), &ula, nullptr);
+            headless.getRegisters()->PC = 0x6000;
+            headless.setDebugging(true);
+            headless.simulateFrame();
+
+            std::cout << "Instructions traced: " << debugger.getTrace()->size() << std::endl;
+            return fastIgnored && waitedForFrame && traced && !headless.isDebugging();
+        }
+    });
+
+    // The FD and FDCB pages are generated from the same handlers as DD and DDCB,
+    // so each FD opcode must act on IY exactly as its DD twin acts on IX
+    addTestCase({
+        "IY instructions mirror the IX ones",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            ULA ula(nullptr);
+            const InstructionTable& table = z80InstructionTable();
+            std::mt19937 rng(14);
+            int mismatches = 0;
+            for (int page = 0; page < 2; page++)
+            {
+                for (int opcode = 0; opcode < 256; opcode++)
+                {
+                    if (page == 0 && (opcode == 0xCB || opcode == 0xDD || opcode == 0xED || opcode == 0xFD))
+                    {
+                        continue;
+                    }
+
+                    std::unique_ptr<Spectrum48KMemory> memories[2] = {
+                        std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory()),
+                        std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory())
+                    };
+                    for (int i = 0; i < Spectrum48KMemory::MEM_SIZE; i++)
+                    {
+                        memories[0]->memory[i] = memories[1]->memory[i] = rng() & 0xFF;
+                    }
+                    Z80Registers start;
+                    uint8_t* bytes = (uint8_t*) &start;
+                    for (int i = 0; i < (int) sizeof(start); i++) { bytes[i] = rng() & 0xFF; }
+                    start.PC = 0x8000;
+                    uint8_t operand = rng() & 0xFF;
+
+                    Z80Registers result[2];
+                    for (int j = 0; j < 2; j++)
+                    {
+                        // DD opcode n n or DD CB d opcode, then the same with FD and IX, IY swapped
+                        Spectrum48KMemory& m = *memories[j];
+                        m[0x8000] = j == 0 ? 0xDD : 0xFD;
+                        m[0x8001] = page == 0 ? opcode : 0xCB;
+                        m[0x8002] = operand;
+                        m[0x8003] = page == 0 ? operand : opcode;
+
+                        Debugger debugger;
+                        Z80 z(&m, &ula, &debugger);
+                        *z.getRegisters() = start;
+                        if (j == 1) { std::swap(z.getRegisters()->IX.word, z.getRegisters()->IY.word); }
+                        z.nextInstruction();
+                        result[j] = *z.getRegisters();
+                    }
+                    std::swap(result[1].IX.word, result[1].IY.word);
+                    memories[1]->memory[0x8000] = memories[0]->memory[0x8000];
+
+                    int ix = page == 0 ? 256 + opcode : 2304 + opcode;
+                    std::string mnemonic = table.cold[ix].mnemonic;
+                    for (size_t c = 1; c < mnemonic.size(); c++)
+                    {
+                        if (mnemonic[c - 1] == 'I' && mnemonic[c] == 'X') { mnemonic[c] = 'Y'; }
+                    }
+                    if (memcmp(&result[0], &result[1], sizeof(Z80Registers)) != 0 ||
+                        memcmp(memories[0]->memory, memories[1]->memory, Spectrum48KMemory::MEM_SIZE) != 0 ||
+                        table.hot[ix].cycles != table.hot[ix + 256].cycles ||
+                        mnemonic != table.cold[ix + 256].mnemonic)
+                    {
+                        std::cout << table.cold[ix].mnemonic << " differs from its IY version" << std::endl;
+                        mismatches++;
+                    }
+                }
+            }
+            return mismatches == 0;
+        }
+    });
+
+    // Each machine cycle of the metadata must be lowered to an access with a
+    // known address
+    addTestCase({
+        "Micro-ops cover every machine cycle",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            const InstructionTable& table = z80InstructionTable();
+            int badPrograms = 0;
+            for (int i = 0; i < NUM_INSTRUCTIONS; i++)
+            {
+                const MicroProgram& program = table.micro[i];
+                if (!table.hot[i].execute) { continue; }
+                int executes = 0;
+                bool unresolved = false;
+                for (int op = 0; op < program.count; op++)
+                {
+                    MicroOpType type = program.ops[op].type;
+                    executes += type == MicroOpType::EXECUTE;
+                    unresolved |= type != MicroOpType::EXECUTE && type != MicroOpType::INTERNAL &&
+                        program.ops[op].source == AddressSource::NONE;
+                }
+                if (executes != 1 || unresolved || program.count != table.cold[i].cntMachineCycles + 1)
+                {
+                    std::cout << table.cold[i].mnemonic << " isn't fully lowered" << std::endl;
+                    badPrograms++;
+                }
+            }
+            return badPrograms == 0;
+        }
+    });
+
+    // Running the micro-ops must report each bus cycle and only add the wait
+    // states. Built with Z80_NO_BUS_LISTENER there is no listener to report to.
+#ifndef Z80_NO_BUS_LISTENER
+    addTestCase({
+        "Micro-ops report every bus cycle",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            // One wait state for every access to 0x4000-0x7FFF
+            struct Recorder : IBusListener {
+                std::vector<std::pair<MicroOpType, uint16_t>> cycles;
+                std::vector<int> tstates;
+                int waits = 0;
+                int length = 0;
+                int busCycle(MicroOpType type, uint16_t address, int tstate, int cycleLength) override
+                {
+                    cycles.push_back({ type, address });
+                    tstates.push_back(tstate);
+                    length += cycleLength;
+                    bool contended = (address & 0xC000) == 0x4000;
+                    waits += contended;
+                    return contended;
+                }
+            };
+
+            ULA ula(nullptr);
+            std::unique_ptr<Spectrum48KMemory> memories[2] = {
+                std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory()),
+                std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory())
+            };
+            // LD BC,0x6000; LD A,(BC); PUSH HL; EX (SP),HL; LD (IX+5),0x42; JR NZ,+2
+            const uint8_t program[] = { 0x01, 0x00, 0x60, 0x0A, 0xE5, 0xE3, 0xDD, 0x36, 0x05, 0x42, 0x20, 0x02 };
+            Recorder recorder;
+            Z80Registers result[2];
+            int cycles[2];
+            for (int j = 0; j < 2; j++)
+            {
+                Spectrum48KMemory& m = *memories[j];
+                for (int i = 0; i < (int) sizeof(program); i++) { m[0x8000 + i] = program[i]; }
+                Z80 z(&m, &ula, nullptr);
+                z.getRegisters()->PC = 0x8000;
+                z.getRegisters()->SP = 0x7000;
+                z.getRegisters()->IX.word = 0x6000;
+                z.getRegisters()->AF.word = 0x0040;     // ZF, JR NZ isn't taken
+                if (j == 1) { z.setBusListener(&recorder); }
+                for (int i = 0; i < 6; i++) { z.nextInstruction(); }
+                result[j] = *z.getRegisters();
+                cycles[j] = z.getCyclesSinceLastFrame();
+            }
+
+            const MicroOpType F = MicroOpType::FETCH, R = MicroOpType::READ, W = MicroOpType::WRITE;
+            const std::vector<std::pair<MicroOpType, uint16_t>> expected = {
+                { F, 0x8000 }, { R, 0x8001 }, { R, 0x8002 },
+                { F, 0x8003 }, { R, 0x6000 },
+                { F, 0x8004 }, { W, 0x6FFF }, { W, 0x6FFE },
+                { F, 0x8005 }, { R, 0x6FFE }, { R, 0x6FFF }, { W, 0x6FFF }, { W, 0x6FFE },
+                { F, 0x8006 }, { F, 0x8007 }, { R, 0x8008 }, { MicroOpType::INTERNAL, 0x8008 }, { R, 0x8009 }, { W, 0x6005 },
+                { F, 0x800A }, { R, 0x800B }
+            };
+
+            std::cout << "Wait states inserted: " << recorder.waits << std::endl;
+            return recorder.cycles == expected && recorder.tstates[4] == 14 &&
+                std::is_sorted(recorder.tstates.begin(), recorder.tstates.end()) &&
+                recorder.waits == 8 && cycles[1] == cycles[0] + recorder.waits && recorder.length == cycles[0] &&
+                memcmp(&result[0], &result[1], sizeof(Z80Registers)) == 0 &&
+                memcmp(memories[0]->memory, memories[1]->memory, Spectrum48KMemory::MEM_SIZE) == 0;
+        }
+    });
+#endif
+
+    // Fused runs must stop on the same instruction as single ones at any slice
+    // boundary, and must not run an INC HL their own write replaced. They live
+    // in the block cache, the switch core has none.
+#ifndef Z80_SWITCH_CORE
+    addTestCase({
+        "Superinstructions match single instructions",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            ULA ula(nullptr);
+            std::unique_ptr<Spectrum48KMemory> memories[2] = {
+                std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory()),
+                std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory())
+            };
+            const uint8_t program[] = {
+                0x21, 0x06, 0x70,       // 7000  LD HL,7006h
+                0x3E, 0x2B,             // 7003  LD A,2Bh
+                0x77,                   // 7005  LD (HL),A, replaces the INC HL with DEC HL
+                0x23,                   // 7006  INC HL
+                0x22, 0x00, 0x63,       // 7007  LD (6300h),HL
+                0x21, 0x00, 0x61,       // 700A  LD HL,6100h
+                0x11, 0x00, 0x62,       // 700D  LD DE,6200h
+                0x01, 0x40, 0x00,       // 7010  LD BC,0040h
+                0x7E, 0x23,             // 7013  loop: LD A,(HL); INC HL
+                0x12, 0x13,             // 7015  LD (DE),A; INC DE
+                0x1A, 0x13,             // 7017  LD A,(DE); INC DE
+                0x77, 0x23,             // 7019  LD (HL),A; INC HL
+                0x0B, 0x78, 0xB1,       // 701B  DEC BC; LD A,B; OR C
+                0x20, 0xF3,             // 701E  JR NZ,loop
+                0xC3, 0x00, 0x70        // 7020  JP 7000h
+            };
+            const uint64_t end = 3 * Z80::FRAME_CYCLES;
+
+            Z80Registers result[2];
+            uint64_t tstates[2];
+            uint64_t fused = 0;
+            for (int j = 0; j < 2; j++)
+            {
+                Spectrum48KMemory& m = *memories[j];
+                for (int i = 0; i < (int) sizeof(program); i++) { m[0x7000 + i] = program[i]; }
+                for (int i = 0; i < 0x100; i++) { m[0x6100 + i] = i * 7; }
+
+                Z80 z(&m, &ula, nullptr);
+                z.setSuperinstructionsEnabled(j == 1);
+                z.getRegisters()->PC = 0x7000;
+                for (uint64_t t = 0; t < end; t += 777) { z.runUntil(t); }
+                z.runUntil(end);
+                result[j] = *z.getRegisters();
+                tstates[j] = z.getTStates();
+                fused = z.getBlockCacheStats().superinstructions;
+            }
+
+            std::cout << "Superinstructions run: " << fused << std::endl;
+            return fused > 0 && (*memories[1])[0x6300] == 0x05 && (*memories[1])[0x6301] == 0x70 &&
+                memcmp(&result[0], &result[1], sizeof(Z80Registers)) == 0 && tstates[0] == tstates[1] &&
+                memcmp(memories[0]->memory, memories[1]->memory, Spectrum48KMemory::MEM_SIZE) == 0;
+        }
+    });
+#endif
+
+    // The scheduled frame interrupt must hit the same instruction as calling
+    // nmi() before each frame, other events run before the first instruction
+    // starting at or past their deadline
+    addTestCase({
+        "Scheduled events run at their deadlines",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            struct Recorder : IEventHandler {
+                Z80* z = nullptr;
+                Scheduler::EventId id = 0;
+                std::vector<std::pair<uint64_t, uint64_t>> calls;     // Deadline, clock
+                void handleEvent(uint64_t deadline) override
+                {
+                    calls.push_back({ deadline, z->getTStates() });
+                    if (calls.size() < 50) { z->getScheduler().schedule(id, deadline + 4321); }
+                }
+            };
+
+            ULA ula(nullptr);
+            std::unique_ptr<Spectrum48KMemory> memories[2] = {
+                std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory()),
+                std::unique_ptr<Spectrum48KMemory>(new Spectrum48KMemory())
+            };
+            Recorder recorder;
+            Z80Registers result[2];
+            uint64_t tstates[2];
+            for (int j = 0; j < 2; j++)
+            {
+                Spectrum48KMemory& m = *memories[j];
+                // EI; loop: INC A; LD (HL),A; INC HL; JR loop, the handler at 0038h counts in B
+                const uint8_t program[] = { 0xFB, 0x3C, 0x77, 0x23, 0x18, 0xFB };
+                for (int i = 0; i < (int) sizeof(program); i++) { m[0x6000 + i] = program[i]; }
+                m.poke(0x38, 0x04); m.poke(0x39, 0xFB); m.poke(0x3A, 0xC9);     // INC B; EI; RET
+
+                Z80 z(&m, &ula, nullptr);
+                z.getRegisters()->PC = 0x6000;
+                z.getRegisters()->SP = 0x6000;
+                z.getRegisters()->HL.word = 0x7000;
+                z.getRegisters()->BC.word = 0;
+                z.setInterruptMode(1);
+                if (j == 1)
+                {
+                    z.setFrameInterrupt(true);
+                    recorder.z = &z;
+                    recorder.id = z.getScheduler().addEvent(&recorder);
+                    z.getScheduler().schedule(recorder.id, 1001);
+                }
+                for (int frame = 0; frame < 5; frame++)
+                {
+                    if (j == 0) { z.nmi(); }
+                    z.simulateFrame();
+                }
+                result[j] = *z.getRegisters();
+                tstates[j] = z.getTStates();
+            }
+
+            bool onTime = recorder.calls.size() == 50;
+            for (const auto& call : recorder.calls)
+            {
+                onTime &= call.second >= call.first && call.second < call.first + 23;
+            }
+            std::cout << "Interrupts taken: " << +result[1].BC.bytes.high << std::endl;
+            return onTime && result[1].BC.bytes.high == 4 &&
+                memcmp(&result[0], &result[1], sizeof(Z80Registers)) == 0 && tstates[0] == tstates[1] &&
+                memcmp(memories[0]->memory, memories[1]->memory, Spectrum48KMemory::MEM_SIZE) == 0;
+        }
+    });
+
+    // Block cache and single step runs must hash the same every frame, only
+    // pages written since the last frame are rehashed, and a byte poked into one
+    // run is found as the first diverging frame
+    addTestCase({
+        "State hash finds the first diverging frame",
+        [](Z80& cpu, Spectrum48KMemory& mem) {
+            resetFixture(cpu, mem);
+            // LD HL,4000h; loop: INC (HL); INC HL; JR loop
+            const uint8_t program[] = { 0x21, 0x00, 0x40, 0x34, 0x23, 0x18, 0xFC };
+            for (int i = 0; i < (int) sizeof(program); i++) { mem[0x8000 + i] = program[i]; }
+            cpu.getRegisters()->PC = 0x8000;
+        },
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            // The fixture, a copy single stepping and one a byte is poked into
+            FixtureCopy stepped(cpu, mem, true);
+            FixtureCopy poked(cpu, mem, false);
+            Z80* cpus[3] = { &cpu, &stepped.cpu, &poked.cpu };
+            Spectrum48KMemory* memories[3] = { &mem, stepped.memory.get(), poked.memory.get() };
+
+            std::vector<uint64_t> hashes[3];
+            std::vector<uint64_t> chains[3];
+            int pagesHashed = 0;
+            bool fresh = true;
+            for (int j = 0; j < 3; j++)
+            {
+                Z80& z = *cpus[j];
+                Spectrum48KMemory& m = *memories[j];
+                StateHash stateHash;
+                for (int frame = 0; frame < 6; frame++)
+                {
+                    if (j == 2 && frame == 4) { m[0xA000] = 0x55; }
+                    z.simulateFrame();
+                    hashes[j].push_back(stateHash.update(z, m));
+                    chains[j].push_back(stateHash.getChain());
+                    pagesHashed = stateHash.getPagesHashed();
+                }
+                StateHash full;
+                fresh &= full.update(z, m) == hashes[j].back();
+            }
+
+            std::mt19937 random(19);
+            uint8_t page[StateHash::PAGE_SIZE];
+            bool simd = true;
+            for (int i = 0; i < 100; i++)
+            {
+                for (uint8_t& byte : page) { byte = (uint8_t) random(); }
+                simd &= StateHash::hashPage(page, i) == StateHash::hashPageScalar(page, i);
+            }
+
+            // A 128K frame that writes no paged out bank rehashes none of them, a
+            // write to one rehashes its page alone (and the slot paged over it)
+            ULA ula(nullptr);
+            std::unique_ptr<Spectrum128KMemory> memory128(new Spectrum128KMemory());
+            Spectrum128KMemory& m128 = *memory128;
+            // DI; JR $
+            const uint8_t idle[] = { 0xF3, 0x18, 0xFE };
+            for (int i = 0; i < (int) sizeof(idle); i++) { m128[0x8000 + i] = idle[i]; }
+            Debugger debugger128;
+            Z80 z128(&m128, &ula, &debugger128);
+            z128.getRegisters()->PC = 0x8000;
+            StateHash stateHash128;
+            for (int frame = 0; frame < 2; frame++)
+            {
+                z128.simulateFrame();
+                stateHash128.update(z128, m128);
+            }
+            int quietPages = stateHash128.getPagesHashed();
+            m128.setPaging(0x01);
+            m128[0xC000] = 0x55;
+            m128.setPaging(0x00);
+            z128.simulateFrame();
+            uint64_t written = stateHash128.update(z128, m128);
+            int writtenPages = stateHash128.getPagesHashed();
+            StateHash full128;
+            bool banked = quietPages == 0 && writtenPages == Spectrum48KMemory::BANK_PAGES + 1 &&
+                full128.update(z128, m128) == written;
+
+            std::cout << "Pages rehashed in the last frame: " << pagesHashed << std::endl;
+            return hashes[0] == hashes[1] && chains[0] == chains[1] && hashes[0][0] != hashes[0][1] &&
+                StateHash::firstDivergence(chains[0], chains[1]) == 6 &&
+                StateHash::firstDivergence(chains[0], chains[2]) == 4 &&
+                pagesHashed > 0 && pagesHashed < 20 && fresh && simd && banked;
+        }
+    });
+
+    // Delays from the frame table and each kind of bus cycle against the cycle
+    // patterns documented for the 48K
+    addTestCase({
+        "ULA contention follows the 48K and 128K timings",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            ULA ula(nullptr);
+            std::unique_ptr<Spectrum48KMemory> memory(new Spectrum48KMemory());
+            std::unique_ptr<Spectrum128KMemory> memory128(new Spectrum128KMemory());
+            Z80Registers registers = {};
+            ULAContention contention(memory.get(), &registers);
+            ULAContention contention128(memory128.get(), &registers);
+
+            const int first = ULAContention::TIMING_48K.firstContended;
+            const int pattern[8] = { 6, 5, 4, 3, 2, 1, 0, 0 };
+            bool table = contention.delay(first - 1) == 0 && contention.delay(first + 128) == 0 &&
+                contention.delay(first + 224) == 6 && contention.delay(first + 191 * 224 + 121) == 5 &&
+                contention.delay(first + 192 * 224) == 0 && contention.delay(-1) == 0 &&
+                contention.delay(Z80::FRAME_CYCLES) == 0 &&
+                contention128.delay(14361) == 6 && contention128.delay(14361 + 228 + 1) == 5 &&
+                contention128.delay(first) == 0;
+            for (int n = 0; n < 8; n++) { table &= contention.delay(first + n) == pattern[n]; }
+
+            const MicroOpType F = MicroOpType::FETCH, R = MicroOpType::READ, I = MicroOpType::INTERNAL;
+            const MicroOpType IN = MicroOpType::PORT_READ;
+            registers.IR.word = 0x4000;
+            bool cycles = contention.busCycle(F, 0x4000, first, 4) == 6 &&
+                contention.busCycle(R, 0x8000, first, 3) == 0 &&
+                contention.busCycle(R, 0x5000, first + 1, 3) == 5 &&
+                contention.busCycle(F, 0x8000, first - 4, 6) == 6 &&     // IR in the extra T-states
+                contention.busCycle(R, 0x4000, first, 4) == 11 &&        // C:3, C:1
+                contention.busCycle(I, 0x4000, first + 6, 5) == 12 &&    // C:1 x5
+                contention.busCycle(IN, 0x00FE, first - 1, 4) == 6 &&    // N:1, C:3
+                contention.busCycle(IN, 0x80FF, first, 4) == 0 &&        // N:4
+                contention.busCycle(IN, 0x40FE, first, 4) == 6 &&        // C:1, C:3
+                contention.busCycle(IN, 0x40FF, first, 4) == 12;         // C:1 x4
+
+            // Odd banks are contended wherever they are paged
+            bool banks = contention128.isContended(0x4000) && !contention128.isContended(0x8000) &&
+                !contention128.isContended(0xC000) && !contention128.isContended(0x0000);
+            memory128->setPaging(0x03);
+            banks &= contention128.isContended(0xC000);
+            memory128->setPaging(0x04);
+            banks &= !contention128.isContended(0xC000) && contention.isContended(0x7FFF) &&
+                !contention.isContended(0x3FFF);
+
+            return table && cycles && banks;
+        }
+    });
+
+    // NOPs from 4000h: 3584 run uncontended up to T-state 14332, one waits 5 and
+    // ends 3 T-states into the next slot, 15 wait 4 up to the end of the
+    // contended part of the line and 24 run free until the next line. Needs the
+    // bus listener, which Z80_NO_BUS_LISTENER compiles out.
+#ifndef Z80_NO_BUS_LISTENER
+    addTestCase({
+        "Contended NOPs follow the 48K timing",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            ULA ula(nullptr);
+            std::unique_ptr<Spectrum48KMemory> memory(new Spectrum48KMemory());
+            const int first = ULAContention::TIMING_48K.firstContended;
+
+            Z80 z(memory.get(), &ula, nullptr);
+            ULAContention contention(memory.get(), z.getRegisters());
+            z.getRegisters()->PC = 0x4000;
+            z.setBusListener(&contention);
+            for (int i = 0; i < 3624; i++) { z.nextInstruction(); }
+
+            std::cout << "NOP sled ended at T-state " << z.getCyclesSinceLastFrame() << std::endl;
+            return z.getRegisters()->PC == 0x4000 + 3624 && z.getCyclesSinceLastFrame() == first + 226;
+        }
+    });
+#endif
+
+    initializeMemoryTests();
+
     // Add more tests here
     std::cout << "All tests initialized." << std::endl; // Debugging output
 }
 
 // The runner function that goes through each test case
-void runAllTests() {
+bool runAllTests() {
     std::cout << "Starting tests..." << std::endl;
 
     try {
-        Z80 cpu(nullptr, nullptr, nullptr); // Adjust as necessary for your Z80 constructor
         Spectrum48KMemory mem;
+        ULA ula(nullptr);
+        Debugger debugger;
+        Z80 cpu(&mem, &ula, &debugger);
         initializeTests();
 
         int passedTests = 0;
@@ -63,11 +931,13 @@ void runAllTests() {
         }
 
         std::cout << "Tests passed: " << passedTests << "/" << allTests.size() << std::endl;
+        return passedTests == (int) allTests.size();
     } catch (const std::exception& e) {
         std::cerr << "Exception caught in runAllTests: " << e.what() << std::endl;
     } catch (...) {
         std::cerr << "Unknown exception caught in runAllTests." << std::endl;
     }
+    return false;
 }
 
 // Remember to call runAllTests() in your main or wherever appropriate
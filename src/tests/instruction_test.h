@@ -15,7 +15,13 @@ struct TestCase {
     std::function<bool(Z80&, Spectrum48KMemory&)> test;    // The test to run, which should return true if the test passes
 };
 
-// Runs all tests for the Z80 CPU
-void runAllTests();
+// Adds a test case for runAllTests
+void addTestCase(const TestCase& testCase);
+
+// Adds the memory, paging, screen tracking and snapshot tests (memory_tests.cpp)
+void initializeMemoryTests();
+
+// Runs all tests for the Z80 CPU, true if every one passed
+bool runAllTests();
 
 #endif // INSTRUCTION_TEST_H
@@ -0,0 +1,224 @@
+#include "instruction_test.h"
+#include "../debugger.h"
+#include "../ULA.h"
+#include "../snapshot.h"
+#include "../spectrum128k.h"
+
+#include <memory>
+
+// Tests of Spectrum48KMemory and the machines built on it, run by runAllTests
+void initializeMemoryTests() {
+    // The top 16K is RAM like the rest, ROM ignores writes and a remapped slot
+    // shows its new bank at once, including to code already decoded from it
+    addTestCase({
+        "Memory slots map the full 64K",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            ULA ula(nullptr);
+            Debugger debugger;
+            std::unique_ptr<Spectrum48KMemory> memory(new Spectrum48KMemory());
+            Spectrum48KMemory& m = *memory;
+
+            m[0xFFFF] = 0x12;
+            m[0x0038] = 0x34;
+            bool ram = m[0xFFFF] == 0x12 && m.memory[0xFFFF] == 0x12;
+            bool rom = m[0x0038] == 0x00;
+            m.poke(0x0038, 0x34);
+            rom &= m[0x0038] == 0x34;
+
+            // LD A,(4000h); JR 0C000h, running at C000h
+            const uint8_t program[] = { 0x3A, 0x00, 0x40, 0x18, 0xFB };
+            for (int i = 0; i < (int) sizeof(program); i++) { m[0xC000 + i] = program[i]; }
+            m[0x4000] = 0x01;
+            Z80 z(&m, &ula, &debugger);
+            z.getRegisters()->PC = 0xC000;
+            z.runUntil(1000);
+            uint8_t before = z.getRegisters()->AF.bytes.high;
+
+            // Show the bank at 4000h at C000h too and copy the loop into it, so
+            // LD A,(4000h) reads the loop's own first byte
+            m.mapSlot(3, &m.memory[0x4000], true);
+            for (int i = 0; i < (int) sizeof(program); i++) { m[0xC000 + i] = program[i]; }
+            z.runUntil(2000);
+            bool remapped = m[0x4000] == 0x3A && m.memory[0xC000] == 0x3A && m.memory[0x4003] == 0x18 &&
+                z.getRegisters()->AF.bytes.high == 0x3A;
+
+            return ram && rom && before == 0x01 && remapped;
+        }
+    });
+
+    // Port 7FFDh pages RAM banks into C000h and picks the ROM and screen by
+    // moving slot pointers, a paged out bank keeps what was written to it
+    addTestCase({
+        "128K paging swaps banks without copying",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            ULA ula(nullptr);
+            Debugger debugger;
+            std::unique_ptr<Spectrum128KMemory> memory(new Spectrum128KMemory());
+            Spectrum128KMemory& m = *memory;
+            Spectrum128KPaging paging(&m);
+
+            // LD BC,7FFDh; LD A,1; OUT (C),A; LD A,0AAh; LD (0C000h),A;
+            // LD A,3; OUT (C),A; LD A,(0C000h); LD D,A;
+            // LD A,1; OUT (C),A; LD A,(0C000h); LD E,A; LD A,18h; OUT (C),A; HALT
+            const uint8_t program[] = {
+                0x01, 0xFD, 0x7F, 0x3E, 0x01, 0xED, 0x79, 0x3E, 0xAA, 0x32, 0x00, 0xC0,
+                0x3E, 0x03, 0xED, 0x79, 0x3A, 0x00, 0xC0, 0x57,
+                0x3E, 0x01, 0xED, 0x79, 0x3A, 0x00, 0xC0, 0x5F, 0x3E, 0x18, 0xED, 0x79, 0x76
+            };
+            for (int i = 0; i < (int) sizeof(program); i++) { m[0x8000 + i] = program[i]; }
+
+            Z80 z(&m, &ula, &debugger);
+            z.getIoPorts()->registerDevice(&paging);
+            z.getRegisters()->PC = 0x8000;
+            z.runUntil(1000);
+
+            Z80Registers* r = z.getRegisters();
+            bool banks = m.ram[2][0] == 0x01 && m.ram[1][0] == 0xAA && m.ram[3][0] == 0x00 &&
+                r->DE.bytes.high == 0x00 && r->DE.bytes.low == 0xAA;
+            bool pointers = m.readSlots[0] == m.rom[1] && m.readSlots[3] == m.ram[0] &&
+                m.writeSlots[0] == m.sink && m.screenMemory == m.ram[7];
+
+            // Locked until reset
+            m.setPaging(0x24);
+            m.setPaging(0x01);
+            bool locked = m.readSlots[3] == m.ram[4];
+            m.resetPaging();
+            locked &= m.readSlots[3] == m.ram[0] && m.readSlots[0] == m.rom[0] && m.screenMemory == m.ram[5];
+
+            return banks && pointers && locked;
+        }
+    });
+
+    // Writes to the pixels or attribute of a cell mark it, other writes don't,
+    // and the 128K tracks whichever screen is shown wherever it's paged
+    addTestCase({
+        "Screen writes mark dirty character cells",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            std::unique_ptr<Spectrum48KMemory> memory(new Spectrum48KMemory());
+            Spectrum48KMemory& m = *memory;
+            auto dirtyCells = [](const Spectrum48KMemory& m) {
+                std::vector<int> cells;
+                for (int c = 0; c < Spectrum48KMemory::SCREEN_CELLS; c++)
+                {
+                    if (m.isScreenCellDirty(c)) { cells.push_back(c); }
+                }
+                return cells;
+            };
+
+            bool initial = (int) dirtyCells(m).size() == Spectrum48KMemory::SCREEN_CELLS;
+            m.clearScreenDirty();
+            m.write(0x8000, 1);
+            m.write(0x3FFF, 1);
+            m.write(0x5B00, 1);
+            bool clean = dirtyCells(m).empty() && !m.isScreenDirty();
+
+            // Pixel line 1 of row 1 column 1, line 7 of row 23 column 31, the last attribute
+            m.write(0x4121, 1);
+            m.write(0x57FF, 1);
+            m.poke(0x5AFF, 1);
+            bool cells = dirtyCells(m) == std::vector<int>({ 33, 767 }) &&
+                m.isScreenRowDirty(1) && m.isScreenRowDirty(23) && !m.isScreenRowDirty(0);
+
+            // LDIR through the copy fast path into the first attribute row
+            m.clearScreenDirty();
+            m.copy(0x5800, 0x8000, 32, 1);
+            std::vector<int> row0;
+            for (int c = 0; c < 32; c++) { row0.push_back(c); }
+            bool copied = dirtyCells(m) == row0;
+
+            std::unique_ptr<Spectrum128KMemory> memory128(new Spectrum128KMemory());
+            Spectrum128KMemory& m128 = *memory128;
+            m128.clearScreenDirty();
+            m128.setPaging(0x07);
+            m128.write(0xC000, 1);              // Bank 7 isn't shown yet
+            bool shadow = !m128.isScreenDirty();
+            m128.setPaging(0x0F);               // Showing it redraws everything
+            shadow &= (int) dirtyCells(m128).size() == Spectrum48KMemory::SCREEN_CELLS;
+            m128.clearScreenDirty();
+            m128.write(0xD800, 1);
+            m128.write(0x4000, 1);              // Bank 5, no longer shown
+            shadow &= dirtyCells(m128) == std::vector<int>({ 0 });
+
+            return initial && clean && cells && copied && shadow;
+        }
+    });
+
+    // Restoring puts back memory, paging and CPU so the run repeats exactly,
+    // and a snapshot only holds the pages written after it
+    addTestCase({
+        "Snapshots copy pages on first write and restore them",
+        [](Z80& cpu, Spectrum48KMemory& mem) {},
+        [](Z80& cpu, Spectrum48KMemory& mem) -> bool {
+            ULA ula(nullptr);
+            std::unique_ptr<Spectrum48KMemory> memory(new Spectrum48KMemory());
+            Spectrum48KMemory& m = *memory;
+            auto image = [](const Spectrum48KMemory& m) {
+                std::vector<uint8_t> bytes(Spectrum48KMemory::MEM_SIZE);
+                for (int i = 0; i < Spectrum48KMemory::MEM_SIZE; i++) { bytes[i] = m.read((uint16_t) i); }
+                return bytes;
+            };
+
+            // LD HL,6000h; loop: LD (HL),A; INC HL; INC A; JR loop
+            const uint8_t program[] = { 0x21, 0x00, 0x60, 0x77, 0x23, 0x3C, 0x18, 0xFB };
+            for (int i = 0; i < (int) sizeof(program); i++) { m[0x9000 + i] = program[i]; }
+            Z80 z(&m, &ula, nullptr);
+            Snapshots snapshots(&z, &m);
+            z.getRegisters()->PC = 0x9000;
+
+            z.runUntil(2000);
+            std::vector<uint8_t> before = image(m);
+            Z80State state = z.saveState();
+            Snapshots::Id first = snapshots.take();
+            bool shared = snapshots.getPagesHeld(first) == 0;
+
+            z.runUntil(4000);
+            m.copy(0xA000, 0x9000, 600, 1);     // Three pages through the LDIR fast path
+            m.write(0x0000, 0xFF);              // ROM, lands in the sink
+            std::vector<uint8_t> after = image(m);
+            uint64_t afterTStates = z.getTStates();
+            int held = snapshots.getPagesHeld(first);
+            bool copied = held == 4 && snapshots.getBytesHeld(first) >= (size_t) held * Spectrum48KMemory::PAGE_SIZE;
+
+            Snapshots::Id second = snapshots.take();
+            z.runUntil(6000);
+            bool restored = snapshots.restore(first) && !snapshots.restore(second) &&
+                image(m) == before && snapshots.getLiveSnapshots() == 1 &&
+                memcmp(z.getRegisters(), &state.registers, sizeof(Z80Registers)) == 0 &&
+                z.getTStates() == state.frameStart + state.cyclesSinceLastFrame;
+
+            // The same run again, decoded code sees the restored pages
+            z.runUntil(4000);
+            m.copy(0xA000, 0x9000, 600, 1);
+            m.write(0x0000, 0xFF);
+            restored &= image(m) == after && z.getTStates() == afterTStates;
+
+            // Releasing the newest hands its pages to the one before
+            snapshots.restore(first);
+            m.write(0x8000, 1);
+            second = snapshots.take();
+            m.write(0x8100, 2);
+            m.write(0x8000, 3);
+            snapshots.release(second);
+            bool released = snapshots.getPagesHeld(first) == 2 && snapshots.restore(first) && image(m) == before;
+
+            // Paging is part of the snapshot, paged out banks are saved as well
+            std::unique_ptr<Spectrum128KMemory> memory128(new Spectrum128KMemory());
+            Spectrum128KMemory& m128 = *memory128;
+            Z80 z128(&m128, &ula, nullptr);
+            Snapshots snapshots128(&z128, &m128);
+            m128.ram[3][0] = 0x33;
+            Snapshots::Id paged = snapshots128.take();
+            m128.setPaging(0x03);
+            m128.write(0xC000, 0x44);
+            m128.setPaging(0x0C);
+            bool banks = snapshots128.restore(paged) && m128.ram[3][0] == 0x33 &&
+                m128.readSlots[3] == m128.ram[0] && m128.pagingState == 0 && m128.screenMemory == m128.ram[5];
+
+            std::cout << "Pages held: " << held << ", " << snapshots.getBytesHeld(first) << " bytes" << std::endl;
+            return shared && copied && restored && released && banks;
+        }
+    });
+}
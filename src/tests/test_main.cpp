@@ -0,0 +1,39 @@
+// Entry point for running the tests and benchmarks headless, links against
+// build/libzxcore.a only (no SDL, GLEW or Windows headers), see the
+// "Build zxcore tests" task
+#include "instruction_test.h"
+#include "decoder_bench.h"
+#include "core_bench.h"
+#include "Z80_tests.h"
+
+// FUSE's tests.in and tests.expected, relative to the workspace the test task
+// runs in. They aren't distributed with the emulator.
+static const char* FUSE_TESTS_IN = "src/tests/fuse/tests.in";
+static const char* FUSE_TESTS_EXPECTED = "src/tests/fuse/tests.expected";
+
+int main()
+{
+    #ifdef RUN_BENCHMARKS
+    runDecoderBenchmark();
+    runCoreBenchmark();
+    runBlockCacheBenchmark("48k.rom");
+    runSuperinstructionBenchmark("48k.rom");
+    runMemoryWriteBenchmark();
+    runStartupBenchmark();
+    return 0;
+    #endif
+    std::cout << "Running Z80 instruction tests..." << std::endl;
+    bool passed = runAllTests();
+
+    Z80Tester fuse;
+    if (std::ifstream(FUSE_TESTS_IN) && std::ifstream(FUSE_TESTS_EXPECTED))
+    {
+        std::cout << "Running FUSE tests..." << std::endl;
+        passed &= fuse.parseTestFiles(FUSE_TESTS_IN, FUSE_TESTS_EXPECTED) && fuse.runTests();
+    }
+    else
+    {
+        std::cout << "FUSE tests NOT RUN, copy tests.in and tests.expected to src/tests/fuse" << std::endl;
+    }
+    return passed ? 0 : 1;
+}
@@ -3,9 +3,11 @@
 
 #include "defines.h"
 #include "Z80.h"
+#include "flag_tables.h"
 
 #include <type_traits>
 #include <limits>
+#include <climits>
 #include <assert.h>
 #include <string>
 #include <fstream>
@@ -137,6 +139,47 @@ constexpr void srl(INT& val, Z80Registers* r)
     r->AF.bytes.low.NF = false;
 }
 
+// Memory operands come in as Spectrum48KMemory::Cell, these shift a copy and
+// write the result back through the cell
+template <typename INT>
+constexpr INT rolc(Spectrum48KMemory::Cell val, bool carry)
+{
+    INT v = val;
+    INT carryOut = rolc<INT>(v, carry);
+    val = v;
+    return carryOut;
+}
+
+template <typename INT>
+constexpr INT rorc(Spectrum48KMemory::Cell val, bool carry)
+{
+    INT v = val;
+    INT carryOut = rorc<INT>(v, carry);
+    val = v;
+    return carryOut;
+}
+
+inline void sla(Spectrum48KMemory::Cell val, Z80Registers* r, bool sll = false)
+{
+    uint8_t v = val;
+    sla(v, r, sll);
+    val = v;
+}
+
+inline void sra(Spectrum48KMemory::Cell val, Z80Registers* r)
+{
+    uint8_t v = val;
+    sra(v, r);
+    val = v;
+}
+
+inline void srl(Spectrum48KMemory::Cell val, Z80Registers* r)
+{
+    uint8_t v = val;
+    srl(v, r);
+    val = v;
+}
+
 // Sign of val
 template <typename T>
 int sgn(T val)
@@ -336,37 +379,11 @@ constexpr void setUndocumentedFlags(INT result, Z80Registers* r)
 
 
 
+// DAA from the flag tables, they are generated from daaCarry() and daaHalfCarry()
 inline void daa(Z80Registers* r)
 {
-    uint8_t A = r->AF.bytes.high;
-    bool H = r->AF.bytes.low.HF;
-    bool C = r->AF.bytes.low.CF;
-    bool N = r->AF.bytes.low.NF;
-
-    bool newCarry = daaCarry(C, A);
-    bool newHalfCarry = daaHalfCarry(N, H, A);
-
-    uint8_t adjust = 0;
-
-    uint8_t oldA = A;
-
-    if ( ((A & 0xF) > 9) || H )
-    {
-        A = ( N ) ? A -= 0x06 : A += 0x06;
-    }
-    // if ( (A & 0xF0) > 0x90 || C )
-    if ( (oldA > 0x99) || C )
-    {
-        A = ( N ) ? A -= 0x60 : A += 0x60;
-    }
-
-    r->AF.bytes.high = A;
-    r->AF.bytes.low.CF = newCarry;
-    r->AF.bytes.low.HF = newHalfCarry;
-    r->AF.bytes.low.SF = A >> 7;
-    setUndocumentedFlags(A, r);
-    r->AF.bytes.low.ZF = A == 0;
-    r->AF.bytes.low.PF = hasEvenParity(A);
+    int adjust = r->AF.bytes.low.CF | (r->AF.bytes.low.HF << 1) | (r->AF.bytes.low.NF << 2);
+    r->AF.word = flagTables.daa[adjust][r->AF.bytes.high];
 }
 
 // Carry flag after DAA operation
@@ -433,6 +450,77 @@ INT bitwiseOr(INT a, INT b, Z80Registers* r)
     return a;    
 }
 
+// 8-bit ALU operations on the flag tables, F matches add() and the bitwise
+// helpers above but is written with one load and one store. b is passed the
+// way add() takes it, negated for SUB, SBC and CP.
+inline uint8_t add8(uint8_t a, uint8_t b, Z80Registers* r)
+{
+    uint8_t& f = r->AF.bytes.low.byte;
+    f = (f & ~FlagTables::ALU_WRITTEN) | flagTables.add[0][a][b];
+    return a + b;
+}
+
+inline uint8_t adc8(uint8_t a, uint8_t b, Z80Registers* r)
+{
+    uint8_t& f = r->AF.bytes.low.byte;
+    uint8_t carry = f & 0x01;
+    f = (f & ~FlagTables::ALU_WRITTEN) | flagTables.add[carry][a][b];
+    return a + b + carry;
+}
+
+inline uint8_t sub8(uint8_t a, uint8_t b, Z80Registers* r)
+{
+    uint8_t& f = r->AF.bytes.low.byte;
+    f = (f & ~FlagTables::ALU_WRITTEN) | flagTables.sub[0][a][b];
+    return a + b;
+}
+
+inline uint8_t sbc8(uint8_t a, uint8_t b, Z80Registers* r)
+{
+    uint8_t& f = r->AF.bytes.low.byte;
+    uint8_t borrow = f & 0x01;
+    f = (f & ~FlagTables::ALU_WRITTEN) | flagTables.sub[borrow][a][b];
+    return a + b - borrow;
+}
+
+inline uint8_t inc8(uint8_t a, Z80Registers* r)
+{
+    uint8_t& f = r->AF.bytes.low.byte;
+    f = (f & ~FlagTables::INC_DEC_WRITTEN) | flagTables.inc[a];
+    return a + 1;
+}
+
+inline uint8_t dec8(uint8_t a, Z80Registers* r)
+{
+    uint8_t& f = r->AF.bytes.low.byte;
+    f = (f & ~FlagTables::INC_DEC_WRITTEN) | flagTables.dec[a];
+    return a - 1;
+}
+
+inline uint8_t and8(uint8_t a, uint8_t b, Z80Registers* r)
+{
+    uint8_t& f = r->AF.bytes.low.byte;
+    a &= b;
+    f = (f & ~FlagTables::ALU_WRITTEN) | flagTables.logic[a] | FlagTables::AND_HALF_CARRY;
+    return a;
+}
+
+inline uint8_t xor8(uint8_t a, uint8_t b, Z80Registers* r)
+{
+    uint8_t& f = r->AF.bytes.low.byte;
+    a ^= b;
+    f = (f & ~FlagTables::ALU_WRITTEN) | flagTables.logic[a];
+    return a;
+}
+
+inline uint8_t or8(uint8_t a, uint8_t b, Z80Registers* r)
+{
+    uint8_t& f = r->AF.bytes.low.byte;
+    a |= b;
+    f = (f & ~FlagTables::ALU_WRITTEN) | flagTables.logic[a];
+    return a;
+}
+
 enum class RetCondition { NZ = 0, Z, NC, C, PO, PE, P, M };
 
 // RET cc instructions
@@ -0,0 +1,21 @@
+#ifndef ZXCORE_H
+#define ZXCORE_H
+
+// Public API of the zxcore library (build/libzxcore.a, which the emulator and
+// the headless tests both link against): the Z80, 48K and 128K memory, ULA, I/O
+// ports, contention, instruction table, scheduler, debugger, state hash and
+// snapshots. Nothing here depends on SDL or OpenGL, frontends provide an
+// IKeyboard for the ULA.
+#include "Memory.h"
+#include "ULA.h"
+#include "devices.h"
+#include "scheduler.h"
+#include "instructions.h"
+#include "Z80.h"
+#include "debugger.h"
+#include "state_hash.h"
+#include "spectrum128k.h"
+#include "contention.h"
+#include "snapshot.h"
+
+#endif